@@ -0,0 +1,555 @@
+#include <rfl.hpp>
+#include <rfl/json.hpp>
+
+#include "factorys.hpp"
+#include "flow-compile.hpp"
+#include "flow-mat.hpp"
+#include "flow-tile.hpp"
+#include "flow.hpp"
+
+#include <global-variables-pool.hpp>
+
+#define RUNTIME_VISUALIZER_IMPLEMENTATION
+#include <runtime-visualizer.hpp>
+#include <runtime-visualizer-image_watcher.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 基准结果：每项记录中位数与最快一轮的单次耗时，items 为每轮处理的条目数
+struct bench_result
+{
+    std::string name;
+    size_t items = 0;
+    size_t rounds = 0;
+    double median_ns = 0;
+    double min_ns = 0;
+    double items_per_second = 0;
+    std::optional<std::string> note;
+};
+
+struct bench_report
+{
+    std::string project = "core-flow-visualisation";
+    std::string version = BENCH_PROJECT_VERSION;
+    std::string compiler;
+    std::vector<bench_result> results;
+};
+
+static std::string compiler_name()
+{
+#if defined(__clang__)
+    return "clang " __clang_version__;
+#elif defined(_MSC_VER)
+    return "msvc " + std::to_string(_MSC_VER);
+#elif defined(__GNUC__)
+    return "gcc " __VERSION__;
+#else
+    return "unknown";
+#endif
+}
+
+// setup 不计时，每轮调用一次后再计时 run；run 的返回值被累加以免被优化掉
+template <class Setup, class Run> bench_result measure(std::string name, size_t items, size_t rounds, Setup&& setup, Run&& run)
+{
+    using clock = std::chrono::steady_clock;
+    std::vector<double> samples;
+    samples.reserve(rounds);
+    static volatile size_t sink = 0;
+    for (size_t i = 0; i < rounds; i++)
+    {
+        setup();
+        auto begin = clock::now();
+        sink = sink + static_cast<size_t>(run());
+        auto end = clock::now();
+        samples.push_back(std::chrono::duration<double, std::nano>(end - begin).count());
+    }
+    std::sort(samples.begin(), samples.end());
+
+    bench_result result;
+    result.name = std::move(name);
+    result.items = items;
+    result.rounds = rounds;
+    result.median_ns = samples[samples.size() / 2] / static_cast<double>(items);
+    result.min_ns = samples.front() / static_cast<double>(items);
+    result.items_per_second = result.median_ns > 0 ? 1e9 / result.median_ns : 0;
+    return result;
+}
+template <class Run> bench_result measure(std::string name, size_t items, size_t rounds, Run&& run)
+{
+    return measure(std::move(name), items, rounds, [] {}, std::forward<Run>(run));
+}
+
+using bench_factorys = factory_group_manager<std::function<int()>>;
+
+// 生成 count 条三到四级的路径，各级名字在小范围内重复以产生共享前缀
+static std::vector<std::string> make_factory_paths(size_t count)
+{
+    static const char* categories[] = { "图像", "滤波", "几何", "颜色", "形态学", "特征", "io", "math" };
+    std::vector<std::string> paths;
+    paths.reserve(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        std::string path = categories[i % std::size(categories)];
+        path += "/group_" + std::to_string(i / 7 % 64);
+        if (i % 3 == 0)
+            path += "/子组_" + std::to_string(i % 16);
+        path += "/node_" + std::to_string(i);
+        paths.push_back(std::move(path));
+    }
+    return paths;
+}
+
+static void bench_factorys_suite(std::vector<bench_result>& results, size_t count)
+{
+    auto paths = make_factory_paths(count);
+    auto suffix = "/" + std::to_string(count);
+
+    bench_factorys groups;
+    results.push_back(measure(
+        "factorys.register_absolute_path" + suffix, count, 9, [&] { groups = bench_factorys(); },
+        [&] {
+            for (auto& path : paths)
+                groups.register_group_from_absolute_path(path, [] { return 0; });
+            return groups.groups().size();
+        }));
+
+    std::vector<std::pair<std::string, bench_factorys::functor>> batch;
+    results.push_back(measure(
+        "factorys.register_bulk" + suffix, count, 9,
+        [&] {
+            groups = bench_factorys();
+            batch.clear();
+            for (auto& path : paths)
+                batch.emplace_back(path, [] { return 0; });
+        },
+        [&] {
+            groups.register_group_from_factorys(std::move(batch));
+            return groups.groups().size();
+        }));
+
+    groups.prepare();
+    results.push_back(measure("factorys.visit" + suffix, count, 21, [&] {
+        size_t visited = 0;
+        groups.visit([&](std::span<const std::string_view> path, bench_factorys::stack_status, bool, bench_factorys::group) {
+            visited += path.back().size();
+            return true;
+        });
+        return visited;
+    }));
+    results.push_back(measure("factorys.visit_pruned" + suffix, count, 21, [&] {
+        size_t visited = 0;
+        groups.visit_pruned([&](std::span<const std::string_view> path, bench_factorys::stack_status, bool, bench_factorys::group) {
+            visited += path.back().size();
+            return true;
+        });
+        return visited;
+    }));
+
+    static const char* queries[] = { "node_1", "图像/group", "滤波 node", "geom", "形态学/子组_3/node" };
+    results.push_back(measure("factorys.search" + suffix, std::size(queries), 21, [&] {
+        size_t found = 0;
+        for (auto query : queries)
+            found += groups.search(query, 20).size();
+        return found;
+    }));
+}
+
+struct bench_source_node : node
+{
+    output_port<double> out = add_output<double>("out");
+    void execute(flow_context& ctx) override { ctx.output(out, 1.0); }
+};
+struct bench_work_node : node
+{
+    input_port<double> in = add_input<double>("in");
+    output_port<double> out = add_output<double>("out");
+    void execute(flow_context& ctx) override
+    {
+        double value = ctx.input(in);
+        for (int i = 0; i < 20000; i++)
+            value = value * 0.999999 + 1e-6;
+        ctx.output(out, value);
+    }
+};
+
+// 一个源节点扇出到 width 个互不依赖的计算节点，比较不同并发度下整图的耗时
+static void bench_flow_suite(std::vector<bench_result>& results, size_t width)
+{
+    flow_graph graph;
+    auto source = graph.add(std::make_shared<bench_source_node>());
+    for (size_t i = 0; i < width; i++)
+    {
+        auto work = std::make_shared<bench_work_node>();
+        graph.connect(source, 0, graph.add(work), work->in.index);
+    }
+
+    int max_concurrency = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    for (int concurrency = 1;; concurrency = std::min(concurrency * 2, max_concurrency))
+    {
+        flow_executor executor(concurrency);
+        flow_run_report report;
+        auto result = measure(
+            "flow.run_wide/" + std::to_string(width) + "/threads_" + std::to_string(concurrency), width, 9, [&] { graph.invalidate(); },
+            [&] {
+                report = executor.run(graph);
+                return report.critical_nodes.size();
+            });
+        result.note = "parallelism " + std::to_string(report.parallelism());
+        results.push_back(std::move(result));
+        if (concurrency == max_concurrency)
+            break;
+    }
+
+    // 同一张图开启逐节点采样，与上面未采样的结果对比即为采样开销
+    flow_profiler profiler(width * 16);
+    profiler.set_enabled(true);
+    flow_executor executor(max_concurrency);
+    executor.set_profiler(&profiler);
+    std::vector<flow_profile_record> records;
+    results.push_back(measure(
+        "flow.run_wide/" + std::to_string(width) + "/profiled", width, 9, [&] { graph.invalidate(); },
+        [&] {
+            auto report = executor.run(graph);
+            records.clear();
+            profiler.drain(records);
+            return records.size();
+        }));
+}
+
+struct bench_variable
+{
+    uint64_t payload[4] = {};
+};
+
+// 多个线程同时对 global::create/get/destroy 施压，统计每次操作的平均耗时
+static void bench_global_suite(std::vector<bench_result>& results)
+{
+    constexpr size_t operations = 20000;
+    size_t max_threads = std::max(2u, std::min(8u, std::thread::hardware_concurrency()));
+    for (size_t threads = 1; threads <= max_threads; threads *= 2)
+    {
+        // 线程在计时之外创建与回收：每轮由 start 同时放行、在 finish 汇合，计时只覆盖各线程的施压循环
+        std::barrier start(static_cast<std::ptrdiff_t>(threads + 1));
+        std::barrier finish(static_cast<std::ptrdiff_t>(threads + 1));
+        std::atomic<size_t> hits = 0;
+        bool stop = false;
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; t++)
+            workers.emplace_back([&] {
+                while (true)
+                {
+                    start.arrive_and_wait();
+                    if (stop)
+                        break;
+                    size_t local = 0;
+                    for (size_t i = 0; i < operations; i++)
+                    {
+                        auto id = global::create<bench_variable>();
+                        local += global::get<bench_variable>(id) != nullptr;
+                        global::destroy<bench_variable>(id);
+                    }
+                    hits += local;
+                    finish.arrive_and_wait();
+                }
+            });
+        results.push_back(measure(
+            "global.create_get_destroy/threads_" + std::to_string(threads), operations * threads * 3, 5, [&] { hits = 0; },
+            [&] {
+                start.arrive_and_wait();
+                finish.arrive_and_wait();
+                return hits.load();
+            }));
+        stop = true;
+        start.arrive_and_wait();
+        for (auto& worker : workers)
+            worker.join();
+    }
+}
+
+// 需要可用的显示环境；初始化失败时只记录原因
+static void bench_visualizer_suite(std::vector<bench_result>& results, bool headless)
+{
+    runtime_visualizer viz;
+    if (headless)
+        viz.initialize_headless(runtime_visualizer::headless_options{ .readback = true, .max_fps = 0 });
+    else
+        viz.initialize(true);
+    if (!viz.impl->running)
+    {
+        bench_result skipped;
+        skipped.name = "visualizer";
+        skipped.note = "runtime_visualizer 初始化失败（无可用显示环境），跳过";
+        results.push_back(std::move(skipped));
+        return;
+    }
+
+    constexpr size_t tasks = 10000;
+    auto enqueue = measure("visualizer.main_enqueue", tasks, 5, [&] {
+        std::atomic<size_t> done = 0;
+        for (size_t i = 0; i < tasks; i++)
+            viz.main_enqueue([&done] { done.fetch_add(1, std::memory_order_relaxed); });
+        viz.main_execute([] {});
+        return done.load();
+    });
+    auto task_stats = viz.main_task_stats();
+    enqueue.note = "last drain " + std::to_string(task_stats.last_drain_tasks) + " tasks in " + std::to_string(task_stats.last_drain_ms) + " ms, max latency " +
+                   std::to_string(task_stats.last_drain_max_latency_ms) + " ms";
+    results.push_back(std::move(enqueue));
+
+    // 往返延迟受渲染循环的帧间隔影响，反映任务从提交到在主线程执行完毕的等待时间
+    constexpr size_t round_trips = 60;
+    results.push_back(measure("visualizer.main_execute_round_trip", round_trips, 3, [&] {
+        size_t done = 0;
+        for (size_t i = 0; i < round_trips; i++)
+            viz.main_execute([&done] { done++; });
+        return done;
+    }));
+    // 同样数量的任务用 main_submit 一次提交后再等待，全部在同一帧内完成
+    results.push_back(measure("visualizer.main_submit", round_trips, 3, [&] {
+        std::vector<std::future<size_t>> futures;
+        for (size_t i = 0; i < round_trips; i++)
+            futures.push_back(viz.main_submit([i] { return i; }));
+        size_t sum = 0;
+        for (auto& future : futures)
+            sum += future.get();
+        return sum;
+    }));
+
+    // 无界面模式下以 ImGui 演示窗口为负载统计每帧界面耗时，median / min 取自逐帧的 update + render
+    if (viz.headless())
+    {
+        viz.main_render([] { ImGui::ShowDemoWindow(); });
+        constexpr size_t frames = 240;
+        std::vector<double> samples;
+        double readback_ms = 0;
+        uint64_t last = viz.last_frame_timing().frame;
+        while (samples.size() < frames)
+        {
+            viz.main_execute([] {});
+            auto timing = viz.last_frame_timing();
+            if (timing.frame == last)
+                continue;
+            last = timing.frame;
+            samples.push_back((timing.update_ms + timing.render_ms) * 1e6);
+            readback_ms += timing.readback_ms;
+        }
+        std::sort(samples.begin(), samples.end());
+        runtime_visualizer::frame_image image;
+        viz.read_frame(image);
+
+        bench_result frame;
+        frame.name = "visualizer.headless_frame";
+        frame.items = 1;
+        frame.rounds = frames;
+        frame.median_ns = samples[samples.size() / 2];
+        frame.min_ns = samples.front();
+        frame.items_per_second = 1e9 / frame.median_ns;
+        frame.note = std::to_string(image.width) + "x" + std::to_string(image.height) + ", readback avg " + std::to_string(readback_ms / frames) + " ms";
+        results.push_back(std::move(frame));
+    }
+    viz.destroy();
+}
+
+static void bench_image_watcher_suite(std::vector<bench_result>& results)
+{
+    struct mat_case
+    {
+        const char* name;
+        int type;
+    };
+    static const mat_case cases[] = {
+        { "8UC1", CV_8UC1 }, { "8UC3", CV_8UC3 }, { "8UC4", CV_8UC4 }, { "16UC1", CV_16UC1 }, { "32FC1", CV_32FC1 }, { "32FC3", CV_32FC3 },
+    };
+    constexpr int width = 1920;
+    constexpr int height = 1080;
+    for (auto& [name, type] : cases)
+    {
+        cv::Mat src(height, width, type);
+        cv::randu(src, cv::Scalar::all(0), cv::Scalar::all(CV_MAT_DEPTH(type) == CV_32F ? 1.0 : 255.0));
+        results.push_back(measure(std::string("image_watcher.convert_to_rgba/") + name, static_cast<size_t>(width) * height, 15, [&] {
+            auto rgba = image_watcher::convert_to_rgba(src);
+            return rgba.total();
+        }));
+    }
+}
+
+// 逐帧新建并释放整幅图像，对比默认分配器与缓冲池；pool 的统计中 misses 应只在首轮出现
+static void bench_mat_pool_suite(std::vector<bench_result>& results)
+{
+    constexpr size_t frames = 64;
+    constexpr int width = 1920;
+    constexpr int height = 1080;
+    auto touch_frame = [](cv::Mat& frame) {
+        frame.ptr<uchar>(frame.rows - 1)[0] = 1;
+        return frame.total();
+    };
+    results.push_back(measure("mat.create_release/default", frames, 9, [&] {
+        size_t total = 0;
+        for (size_t i = 0; i < frames; i++)
+        {
+            cv::Mat frame(height, width, CV_8UC3);
+            total += touch_frame(frame);
+        }
+        return total;
+    }));
+
+    mat_buffer_pool pool;
+    auto result = measure("mat.create_release/mat_buffer_pool", frames, 9, [&] {
+        size_t total = 0;
+        for (size_t i = 0; i < frames; i++)
+        {
+            auto frame = pool.acquire(height, width, CV_8UC3);
+            total += touch_frame(frame);
+        }
+        return total;
+    });
+    auto stats = pool.stats();
+    result.note = "hits " + std::to_string(stats.hits) + ", misses " + std::to_string(stats.misses) + ", peak bytes " + std::to_string(stats.peak_bytes_total);
+    results.push_back(std::move(result));
+}
+
+struct bench_image_node : node
+{
+    cv::Mat image;
+    output_port<cv::Mat> out = add_output<cv::Mat>("out");
+    void execute(flow_context& ctx) override { ctx.output(out, image); }
+};
+
+// 同一条逐像素链分别逐节点执行与编译融合后执行
+static void bench_fusion_suite(std::vector<bench_result>& results)
+{
+    constexpr int width = 1920;
+    constexpr int height = 1080;
+    flow_graph graph;
+    auto source = std::make_shared<bench_image_node>();
+    source->image.create(height, width, CV_8UC3);
+    cv::randu(source->image, cv::Scalar::all(0), cv::Scalar::all(255));
+    auto previous = graph.add(source);
+    auto previous_port = source->out.index;
+    std::shared_ptr<elementwise_node> chain[] = {
+        std::make_shared<scale_node>(1.2f, -10.0f),
+        std::make_shared<clamp_node>(0.0f, 200.0f),
+        std::make_shared<color_convert_node>(pixel_op::bgr_to_gray()),
+        std::make_shared<scale_node>(0.5f, 3.0f),
+    };
+    for (auto& step : chain)
+    {
+        auto id = graph.add(step);
+        graph.connect(previous, previous_port, id, step->src.index);
+        previous = id;
+        previous_port = step->dst.index;
+    }
+
+    flow_executor executor;
+    results.push_back(measure(
+        "flow.pixel_chain/unfused", static_cast<size_t>(width) * height, 15, [&] { graph.invalidate(); }, [&] { return executor.run(graph).executed.size(); }));
+
+    flow_program program;
+    auto result = measure("flow.pixel_chain/fused", static_cast<size_t>(width) * height, 15, [&] {
+        program.run(graph);
+        return program.plan().size();
+    });
+    result.note = std::to_string(program.fused_node_count()) + " nodes fused into " + std::to_string(program.plan().size()) + " steps";
+    results.push_back(std::move(result));
+}
+
+// 大图上的滤波链：逐节点生成整幅中间结果与分块流过整条链对比，note 中给出分块缓冲总量
+static void bench_tiled_suite(std::vector<bench_result>& results)
+{
+    constexpr int side = 8192;
+    flow_graph graph;
+    auto source = std::make_shared<bench_image_node>();
+    source->image.create(side, side, CV_8UC1);
+    cv::randu(source->image, cv::Scalar::all(0), cv::Scalar::all(255));
+    auto previous = graph.add(source);
+    auto previous_port = source->out.index;
+    std::shared_ptr<tiled_node> chain[] = {
+        std::make_shared<box_blur_node>(2),
+        std::make_shared<scale_node>(1.5f, -20.0f),
+        std::make_shared<gaussian_blur_node>(1.0),
+        std::make_shared<clamp_node>(16.0f, 240.0f),
+    };
+    for (auto& step : chain)
+    {
+        auto id = graph.add(step);
+        graph.connect(previous, previous_port, id, step->src.index);
+        previous = id;
+        previous_port = step->dst.index;
+    }
+    auto pixels = static_cast<size_t>(side) * side;
+
+    flow_executor executor;
+    auto whole = measure("flow.tiled_chain/whole_image", pixels, 5, [&] { graph.invalidate(); }, [&] { return executor.run(graph).executed.size(); });
+    whole.note = "intermediate bytes " + std::to_string(pixels * (std::size(chain) - 1));
+    results.push_back(std::move(whole));
+
+    flow_tiler tiler;
+    auto tiled = measure("flow.tiled_chain/tiled", pixels, 5, [&] {
+        tiler.run(graph);
+        return tiler.stats().tiles;
+    });
+    auto stats = tiler.stats();
+    tiled.note = std::to_string(stats.tiles) + " tiles of " + std::to_string(stats.tile_size) + ", scratch bytes " + std::to_string(stats.scratch_bytes);
+    results.push_back(std::move(tiled));
+}
+
+int main(int argc, char* argv[])
+{
+    std::string out_path;
+    bool with_visualizer = true;
+    bool headless = false;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+        if (arg == "--out" && i + 1 < argc)
+            out_path = argv[++i];
+        else if (arg == "--no-visualizer")
+            with_visualizer = false;
+        else if (arg == "--headless")
+            headless = true;
+        else
+        {
+            std::cerr << "usage: " << argv[0] << " [--out result.json] [--no-visualizer] [--headless]" << std::endl;
+            return 1;
+        }
+    }
+
+    bench_report report;
+    report.compiler = compiler_name();
+    for (size_t count : { size_t(1000), size_t(100000) })
+        bench_factorys_suite(report.results, count);
+    bench_flow_suite(report.results, 256);
+    bench_global_suite(report.results);
+    if (with_visualizer)
+        bench_visualizer_suite(report.results, headless);
+    bench_image_watcher_suite(report.results);
+    bench_mat_pool_suite(report.results);
+    bench_fusion_suite(report.results);
+    bench_tiled_suite(report.results);
+
+    auto json = rfl::json::write(report, rfl::json::pretty);
+    if (out_path.empty())
+    {
+        std::cout << json << std::endl;
+        return 0;
+    }
+    std::ofstream out(out_path, std::ios::binary);
+    if (!out)
+    {
+        std::cerr << "无法写入 " << out_path << std::endl;
+        return 1;
+    }
+    out << json << std::endl;
+    return 0;
+}
@@ -67,42 +67,12 @@ class image_watcher
                 }
                 return std::to_string(channels) + " x " + depth_str;
             };
-            auto convert_to_rgba = [](const cv::Mat& src) {
-                cv::Mat rgba;
-                switch (src.type())
-                {
-                    case CV_8UC1: cv::cvtColor(src, rgba, cv::COLOR_GRAY2RGBA); break;
-                    case CV_8UC3: cv::cvtColor(src, rgba, cv::COLOR_BGR2RGBA); break;
-                    case CV_8UC4: cv::cvtColor(src, rgba, cv::COLOR_BGRA2RGBA); break;
-                    case CV_16UC1:
-                        {
-                            cv::Mat norm;
-                            double minVal, maxVal;
-                            cv::minMaxLoc(src, &minVal, &maxVal);
-                            src.convertTo(norm, CV_8UC1, 255.0 / (maxVal - minVal + 1), -minVal * 255.0 / (maxVal - minVal + 1));
-                            cv::cvtColor(norm, rgba, cv::COLOR_GRAY2RGBA);
-                            break;
-                        }
-                    case CV_32FC1:
-                        {
-                            cv::Mat norm;
-                            cv::normalize(src, norm, 0, 255, cv::NORM_MINMAX, CV_8UC1);
-                            cv::cvtColor(norm, rgba, cv::COLOR_GRAY2RGBA);
-                            break;
-                        }
-                    default:
-                        src.convertTo(rgba, CV_8UC3);
-                        cv::cvtColor(rgba, rgba, cv::COLOR_BGR2RGB);
-                        break;
-                }
-                return rgba;
-            };
             cv::Mat& img = image.get();
             empty = img.empty();
             if (!empty)
             {
                 type_info = type_to_string(img.type());
-                update_texture(convert_to_rgba(img), texture_id, texture_width, texture_height);
+                update_texture(image_watcher::convert_to_rgba(img), texture_id, texture_width, texture_height);
                 float thumb_max_dim = 64.0f;
                 float scale = std::min(thumb_max_dim / img.cols, thumb_max_dim / img.rows);
                 thumb_texture_width = static_cast<int>(img.cols * scale);
@@ -331,15 +301,54 @@ class image_watcher
     };
     std::map<std::string, std::unique_ptr<image_viewer>> viewers;
     std::string selected_name;
+    std::function<void()> update_notifier;
 
 public:
+    // 把任意类型的图像转换为 RGBA8，用于上传纹理
+    static cv::Mat convert_to_rgba(const cv::Mat& src)
+    {
+        cv::Mat rgba;
+        switch (src.type())
+        {
+            case CV_8UC1: cv::cvtColor(src, rgba, cv::COLOR_GRAY2RGBA); break;
+            case CV_8UC3: cv::cvtColor(src, rgba, cv::COLOR_BGR2RGBA); break;
+            case CV_8UC4: cv::cvtColor(src, rgba, cv::COLOR_BGRA2RGBA); break;
+            case CV_16UC1:
+                {
+                    cv::Mat norm;
+                    double minVal, maxVal;
+                    cv::minMaxLoc(src, &minVal, &maxVal);
+                    src.convertTo(norm, CV_8UC1, 255.0 / (maxVal - minVal + 1), -minVal * 255.0 / (maxVal - minVal + 1));
+                    cv::cvtColor(norm, rgba, cv::COLOR_GRAY2RGBA);
+                    break;
+                }
+            case CV_32FC1:
+                {
+                    cv::Mat norm;
+                    cv::normalize(src, norm, 0, 255, cv::NORM_MINMAX, CV_8UC1);
+                    cv::cvtColor(norm, rgba, cv::COLOR_GRAY2RGBA);
+                    break;
+                }
+            default:
+                src.convertTo(rgba, CV_8UC3);
+                cv::cvtColor(rgba, rgba, cv::COLOR_BGR2RGB);
+                break;
+        }
+        return rgba;
+    }
     void destroy() { viewers.clear(); }
     void watch_image(const std::string& var_name, cv::Mat& image, std::function<void()> callback = {}) { viewers[var_name] = std::move(std::make_unique<image_viewer>(image, callback)); }
     void remove_watcher(const std::string& var_name) { viewers.erase(var_name); }
+    // 图像更新后调用，如 [&viz] { viz.request_redraw(); }，让按需重绘的渲染线程画出新图像
+    void set_update_notifier(std::function<void()> notifier) { update_notifier = std::move(notifier); }
     void update_image(const std::string& var_name)
     {
         if (auto it = viewers.find(var_name); it != viewers.end())
+        {
             it->second->update();
+            if (update_notifier)
+                update_notifier();
+        }
     }
     void render()
     {
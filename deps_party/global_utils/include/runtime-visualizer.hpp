@@ -1,27 +1,324 @@
 #pragma once
 // Copyright(c) 2025 Geng Gode
 //
-// need C++17 or higher and dependencies: GLFW, GLAD, ImGui, TBB, spdlog
+// need C++17 or higher and dependencies: GLFW, GLAD, ImGui, spdlog
 
+#include <cstddef>
+#include <cstdint>
+#include <exception>
 #include <functional>
+#include <future>
 #include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#if __has_include(<coroutine>) && defined(__cpp_impl_coroutine)
+    #include <coroutine>
+    #define RUNTIME_VISUALIZER_HAS_COROUTINE 1
+#endif
 
 struct runtime_visualizer
 {
+    // Move-only void() callable for the render thread queues; closures up to inline_size bytes are stored in place,
+    // larger or throwing-move ones on the heap. Converts implicitly from lambdas and std::function
+    class task_t
+    {
+    public:
+        static constexpr size_t inline_size = 6 * sizeof(void*);
+
+    private:
+        struct vtable_t
+        {
+            void (*invoke)(void* storage);
+            // move-constructs into to and destroys from
+            void (*relocate)(void* from, void* to) noexcept;
+            void (*destroy)(void* storage) noexcept;
+        };
+        template <class F> static constexpr bool stored_inline = sizeof(F) <= inline_size && alignof(F) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<F>;
+        template <class F> static const vtable_t* vtable_for()
+        {
+            if constexpr (stored_inline<F>)
+            {
+                static constexpr vtable_t table = {
+                    [](void* storage) { (*std::launder(static_cast<F*>(storage)))(); },
+                    [](void* from, void* to) noexcept {
+                        auto func = std::launder(static_cast<F*>(from));
+                        ::new (to) F(std::move(*func));
+                        func->~F();
+                    },
+                    [](void* storage) noexcept { std::launder(static_cast<F*>(storage))->~F(); },
+                };
+                return &table;
+            }
+            else
+            {
+                static constexpr vtable_t table = {
+                    [](void* storage) { (**static_cast<F**>(storage))(); },
+                    [](void* from, void* to) noexcept { ::new (to) F*(*static_cast<F**>(from)); },
+                    [](void* storage) noexcept { delete *static_cast<F**>(storage); },
+                };
+                return &table;
+            }
+        }
+
+        alignas(std::max_align_t) unsigned char storage[inline_size];
+        const vtable_t* vtable = nullptr;
+
+    public:
+        task_t() noexcept = default;
+        task_t(std::nullptr_t) noexcept {}
+        template <class F, class D = std::decay_t<F>, std::enable_if_t<!std::is_same_v<D, task_t> && std::is_invocable_v<D&>, int> = 0> task_t(F&& func)
+        {
+            // an empty std::function or null function pointer stays an empty task
+            if constexpr (std::is_constructible_v<bool, const D&>)
+                if (!static_cast<bool>(func))
+                    return;
+            if constexpr (stored_inline<D>)
+                ::new (static_cast<void*>(storage)) D(std::forward<F>(func));
+            else
+                ::new (static_cast<void*>(storage)) D*(new D(std::forward<F>(func)));
+            vtable = vtable_for<D>();
+        }
+        task_t(task_t&& other) noexcept
+        {
+            if (other.vtable)
+                other.vtable->relocate(other.storage, storage);
+            vtable = std::exchange(other.vtable, nullptr);
+        }
+        task_t& operator=(task_t&& other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                if (other.vtable)
+                    other.vtable->relocate(other.storage, storage);
+                vtable = std::exchange(other.vtable, nullptr);
+            }
+            return *this;
+        }
+        ~task_t() { reset(); }
+
+        void reset() noexcept
+        {
+            if (vtable)
+                std::exchange(vtable, nullptr)->destroy(storage);
+        }
+        explicit operator bool() const noexcept { return vtable != nullptr; }
+        void operator()() { vtable->invoke(storage); }
+    };
+
+    // Headless mode renders the same ImGui frames into an offscreen framebuffer without a display,
+    // through EGL (surfaceless) or OSMesa on the GLFW null platform, e.g. Mesa llvmpipe on CI and render-farm machines.
+    // There is no input; every frame advances ImGui by a fixed delta_time so the output is reproducible.
+    struct headless_options
+    {
+        int width = 1280;
+        int height = 800;
+        // copy every frame back to memory, see read_frame
+        bool readback = false;
+        // frame rate limit, 0 renders as fast as possible
+        double max_fps = 60.0;
+        float delta_time = 1.0f / 60.0f;
+    };
+    // On-demand mode blocks the render thread until there is input, a queued task or request_redraw,
+    // and otherwise redraws at most max_idle_fps times per second (0 never redraws while idle).
+    // Headless mode ignores it and keeps its own max_fps pacing
+    struct redraw_options
+    {
+        bool on_demand = false;
+        double max_idle_fps = 1.0;
+    };
+    // Milliseconds spent by the latest frame: update covers queued tasks, main_render and ImGui::Render,
+    // render covers the GL draw (waited with glFinish in headless mode), frame is the interval since the previous frame
+    struct frame_timing
+    {
+        uint64_t frame = 0;
+        double update_ms = 0;
+        double render_ms = 0;
+        double readback_ms = 0;
+        double frame_ms = 0;
+        // frames caused by input, tasks or redraw requests vs. frames drawn on the idle timeout; continuous mode only counts active frames
+        uint64_t active_frames = 0;
+        uint64_t idle_frames = 0;
+    };
+    // main queue metrics; the last_drain fields describe the latest frame that ran at least one task,
+    // latency is measured from main_enqueue to the start of the task
+    struct task_stats
+    {
+        // queued tasks plus tasks carried over from a frame whose budget ran out
+        size_t depth = 0;
+        uint64_t executed = 0;
+        size_t last_drain_tasks = 0;
+        double last_drain_ms = 0;
+        double last_drain_max_latency_ms = 0;
+        double last_drain_mean_latency_ms = 0;
+    };
+    // RGBA8 pixels, rows top to bottom
+    struct frame_image
+    {
+        uint64_t frame = 0;
+        int width = 0;
+        int height = 0;
+        std::vector<uint8_t> rgba;
+    };
+
     struct impl_t;
     std::unique_ptr<impl_t> impl;
     runtime_visualizer();
     ~runtime_visualizer();
+    // Starts headless with default options when the environment variable RUNTIME_VISUALIZER_HEADLESS is set
     void initialize(bool sync_wait = false);
+    void initialize_headless(bool sync_wait = true);
+    void initialize_headless(const headless_options& options, bool sync_wait = true);
     void destroy();
-    void register_initialize(std::function<void()> func);
-    void register_destroy(std::function<void()> func);
+    void register_initialize(task_t func);
+    void register_destroy(task_t func);
+    // Replaces the per-frame UI callback from any thread without waiting for the frame in progress, which keeps
+    // running the previous callback; the new one takes effect from the next frame. The old callback is destroyed
+    // on whichever thread drops the last reference, possibly the render thread
     void main_render(std::function<void()> func);
-    void main_enqueue(std::function<void()> func);
-    void main_execute(std::function<void()> func);
+    // The main queue accepts tasks from initialize until the render loop exits; tasks still queued then run before the
+    // registered destroy tasks. A rejected task, or one dropped because initialization failed, is destroyed without running,
+    // so whatever it owns reports the failure (a packaged_task breaks its promise). Returns false when rejected
+    bool main_enqueue(task_t func);
+    // Blocks until func has run on the render thread and rethrows its exception; runs inline when called from the render thread.
+    // Throws std::runtime_error when the render thread is not running
+    void main_execute(task_t func);
+    bool on_render_thread() const;
+
+    // Runs func on the render thread without blocking; the future carries its result or exception.
+    // Called from the render thread, func runs inline and the future is already ready; when the render thread is not running
+    // the future is already failed with std::future_error (broken_promise)
+    template <class F> std::future<std::invoke_result_t<std::decay_t<F>&>> main_submit(F&& func)
+    {
+        std::packaged_task<std::invoke_result_t<std::decay_t<F>&>()> task(std::forward<F>(func));
+        auto future = task.get_future();
+        if (on_render_thread())
+            task();
+        else
+            main_enqueue(std::move(task));
+        return future;
+    }
+
+#ifdef RUNTIME_VISUALIZER_HAS_COROUTINE
+    // co_await viz.main_async(func, executor) runs func on the render thread, then resumes the awaiting coroutine through executor,
+    // so the coroutine continues on its own thread pool instead of the render thread. executor is either a callable taking
+    // std::coroutine_handle<> or a pointer to an object with schedule(std::coroutine_handle<>). The result or exception of func
+    // is returned from co_await; awaited on the render thread, func runs inline without suspending. When the render thread
+    // is not running the coroutine is resumed through executor with std::runtime_error
+    template <class F, class Executor> class main_awaitable
+    {
+        using result_t = std::invoke_result_t<F&>;
+
+        // the queued task; destroyed without running (rejected or dropped), it still resumes the coroutine with an error
+        struct resume_t
+        {
+            main_awaitable* self;
+            std::coroutine_handle<> handle;
+
+            resume_t(main_awaitable* self, std::coroutine_handle<> handle) : self(self), handle(handle) {}
+            resume_t(resume_t&& other) noexcept : self(std::exchange(other.self, nullptr)), handle(other.handle) {}
+            ~resume_t()
+            {
+                if (auto awaitable = std::exchange(self, nullptr))
+                {
+                    awaitable->error = std::make_exception_ptr(std::runtime_error("runtime_visualizer: render thread is not running"));
+                    awaitable->resume(handle);
+                }
+            }
+            void operator()()
+            {
+                auto awaitable = std::exchange(self, nullptr);
+                awaitable->run();
+                awaitable->resume(handle);
+            }
+        };
+
+        runtime_visualizer& viz;
+        F func;
+        Executor executor;
+        std::conditional_t<std::is_void_v<result_t>, bool, std::optional<result_t>> result = {};
+        std::exception_ptr error = nullptr;
+
+        void run() noexcept
+        {
+            try
+            {
+                if constexpr (std::is_void_v<result_t>)
+                    func();
+                else
+                    result.emplace(func());
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+        }
+        // The coroutine frame, this awaitable and its executor member may be gone as soon as handle is resumed,
+        // so the executor is moved out first
+        void resume(std::coroutine_handle<> handle)
+        {
+            auto local = std::move(executor);
+            if constexpr (std::is_pointer_v<Executor>)
+                local->schedule(handle);
+            else
+                local(handle);
+        }
+
+    public:
+        main_awaitable(runtime_visualizer& viz, F func, Executor executor) : viz(viz), func(std::move(func)), executor(std::move(executor)) {}
+
+        bool await_ready()
+        {
+            if (!viz.on_render_thread())
+                return false;
+            run();
+            return true;
+        }
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            viz.main_enqueue(resume_t(this, handle));
+        }
+        result_t await_resume()
+        {
+            if (error)
+                std::rethrow_exception(error);
+            if constexpr (!std::is_void_v<result_t>)
+                return std::move(*result);
+        }
+    };
+    template <class F, class Executor> main_awaitable<std::decay_t<F>, std::decay_t<Executor>> main_async(F&& func, Executor&& executor)
+    {
+        return { *this, std::forward<F>(func), std::forward<Executor>(executor) };
+    }
+#endif
+
     void wait_exit();
+    void set_redraw_options(const redraw_options& options);
+    // Thread-safe; wakes the render thread for at least one more frame in on-demand mode
+    void request_redraw();
+    // Time the render thread may spend on main queue tasks per frame, 0 for no limit; at least one task runs every frame
+    // and the rest are carried over in order to the next frame
+    void set_task_budget(double milliseconds);
+    task_stats main_task_stats() const;
+    bool headless() const;
+    frame_timing last_frame_timing() const;
+    // Copies the latest read back frame into image; false when readback is off or no frame newer than image.frame exists
+    bool read_frame(frame_image& image) const;
 };
 
+#if __has_include(<opencv2/core.hpp>)
+    #include <opencv2/core.hpp>
+// CV_8UC4 view of the frame in RGBA order, valid while image is alive and unchanged
+inline cv::Mat runtime_visualizer_frame_mat(runtime_visualizer::frame_image& image)
+{
+    return cv::Mat(image.height, image.width, CV_8UC4, image.rgba.data());
+}
+#endif
+
 #ifdef RUNTIME_VISUALIZER_IMPLEMENTATION
     #if __has_include(<glad/glad.h>)
         #include <glad/glad.h>
@@ -43,11 +340,6 @@ struct runtime_visualizer
     #else
         #error "<imgui.h> is required for runtime_visualizer implementation"
     #endif
-    #if __has_include(<tbb/concurrent_queue.h>)
-        #include <tbb/concurrent_queue.h>
-    #else
-        #error "<tbb/concurrent_queue.h> is required for runtime_visualizer implementation"
-    #endif
     #if __has_include(<spdlog/spdlog.h>) && RUNTIME_VISUALIZER_ENABLE_LOGGING
         #include <spdlog/spdlog.h>
     #else
@@ -72,126 +364,445 @@ struct runtime_visualizer
         #define set_current_thread_description(description)
     #endif
 
+    #include <algorithm>
     #include <atomic>
+    #include <chrono>
+    #include <cstdlib>
+    #include <filesystem>
     #include <latch>
     #include <mutex>
     #include <thread>
 
+// Multi-producer queue drained by the render thread in batches: producers append under a short lock,
+// the render thread swaps the whole backlog out at once and runs it without touching the lock again.
+// Both vectors keep their capacity, so a steady stream of tasks does not allocate
+class runtime_visualizer_task_queue
+{
+public:
+    using clock = std::chrono::steady_clock;
+    using task_t = runtime_visualizer::task_t;
+
+    struct drain_t
+    {
+        size_t tasks = 0;
+        clock::duration max_latency = {};
+        clock::duration total_latency = {};
+    };
+
+private:
+    struct entry_t
+    {
+        task_t task;
+        clock::time_point queued;
+    };
+
+    std::mutex mutex;
+    std::vector<entry_t> incoming;
+    // owned by the render thread; entries before cursor already ran
+    std::vector<entry_t> batch;
+    size_t cursor = 0;
+    std::atomic<size_t> depth = 0;
+    bool closed = false;
+
+public:
+    runtime_visualizer_task_queue() = default;
+    explicit runtime_visualizer_task_queue(bool open) : closed(!open) {}
+
+    // Returns false and leaves task to be destroyed by the caller when the queue is closed
+    bool push(task_t task)
+    {
+        if (!task)
+            return true;
+        // counted before it becomes visible so that depth never underflows. seq_cst pairs with the render thread's
+        // store of waiting: either it sees this count before blocking, or the producer's wake sees waiting and posts an event
+        depth.fetch_add(1, std::memory_order_seq_cst);
+        auto queued = clock::now();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closed)
+        {
+            depth.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+        incoming.push_back({ std::move(task), queued });
+        return true;
+    }
+    void open()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = false;
+    }
+    // Later pushes are rejected; tasks already queued stay until run_all or cancel_all
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+    }
+    // Destroys the queued tasks without running them
+    void cancel_all()
+    {
+        std::vector<entry_t> cancelled;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            cancelled.swap(incoming);
+        }
+        cancelled.insert(cancelled.end(), std::make_move_iterator(batch.begin() + (ptrdiff_t)cursor), std::make_move_iterator(batch.end()));
+        batch.clear();
+        cursor = 0;
+        depth.fetch_sub(cancelled.size(), std::memory_order_relaxed);
+    }
+    size_t size() const { return depth.load(std::memory_order_seq_cst); }
+    bool empty() const { return size() == 0; }
+
+    // Runs tasks in order until deadline passes, at least one per call so the queue always progresses
+    drain_t run(clock::time_point deadline)
+    {
+        drain_t drain;
+        while (true)
+        {
+            if (cursor == batch.size())
+            {
+                batch.clear();
+                cursor = 0;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    batch.swap(incoming);
+                }
+                if (batch.empty())
+                    break;
+            }
+            auto now = clock::now();
+            if (drain.tasks > 0 && now >= deadline)
+                break;
+            auto& entry = batch[cursor++];
+            drain.tasks++;
+            drain.max_latency = std::max(drain.max_latency, now - entry.queued);
+            drain.total_latency += now - entry.queued;
+            entry.task();
+            // before reset: destroying the task may wake a waiter that reads the depth
+            depth.fetch_sub(1, std::memory_order_relaxed);
+            entry.task.reset();
+        }
+        return drain;
+    }
+    void run_all() { run(clock::time_point::max()); }
+};
+
 struct runtime_visualizer::impl_t
 {
-    tbb::concurrent_queue<std::function<void()>> main_queue = {};
-    tbb::concurrent_queue<std::function<void()>> initialize_queue = {};
-    tbb::concurrent_queue<std::function<void()>> destroy_queue = {};
+    // opened by initialize, closed when the render loop exits
+    runtime_visualizer_task_queue main_queue{ false };
+    runtime_visualizer_task_queue initialize_queue = {};
+    runtime_visualizer_task_queue destroy_queue = {};
+    std::atomic<double> task_budget_ms = 8.0;
+    runtime_visualizer::task_stats tasks = {};
 
-    std::function<void()> main_render_func = {};
-    std::mutex main_render_mutex = {};
+    // published as a whole, the render thread takes its own reference at frame start
+    std::atomic<std::shared_ptr<const std::function<void()>>> main_render_func = {};
 
     std::thread render_thread = {};
+    std::atomic<std::thread::id> render_thread_id = {};
     std::shared_ptr<GLFWwindow> window = {};
     std::atomic<bool> running = false;
     std::atomic<bool> ready = false;
 
+    bool headless = false;
+    std::atomic<bool> on_demand = false;
+    std::atomic<double> max_idle_fps = 1.0;
+    std::atomic<bool> redraw_requested = false;
+    // set while the render thread is blocked in glfwWaitEvents*, wakers only post an empty event then
+    std::atomic<bool> waiting = false;
+    std::mutex wake_mutex = {};
+    runtime_visualizer::headless_options options = {};
+    GLuint framebuffer = 0;
+    GLuint colorbuffer = 0;
+    std::vector<uint8_t> readback_pixels = {};
+
+    runtime_visualizer::frame_timing timing = {};
+    runtime_visualizer::frame_image latest_frame = {};
+    mutable std::mutex frame_mutex = {};
+
+    GLFWwindow* create_window()
+    {
+        if (!headless)
+        {
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+            glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+            return glfwCreateWindow((int)(1280), (int)(800), "Visual", nullptr, nullptr);
+        }
+        // software rasterizers such as llvmpipe are only guaranteed to expose 3.3 core
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        for (int api : { GLFW_EGL_CONTEXT_API, GLFW_OSMESA_CONTEXT_API, GLFW_NATIVE_CONTEXT_API })
+        {
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, api);
+            if (auto glfw_window = glfwCreateWindow(options.width, options.height, "Visual", nullptr, nullptr))
+                return glfw_window;
+        }
+        return nullptr;
+    }
+
+    // The default framebuffer of a surfaceless context is incomplete, headless frames always go to a framebuffer object
+    const char* create_framebuffer()
+    {
+        glGenFramebuffers(1, &framebuffer);
+        glGenRenderbuffers(1, &colorbuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorbuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, options.width, options.height);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorbuffer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            return "Failed to create offscreen framebuffer";
+        return nullptr;
+    }
+
     const char* render_initialize()
     {
         glfwSetErrorCallback([](int error, const char* desc) { SPDLOG_ERROR("GLFW Error {}: {}", error, desc); });
+    #ifdef GLFW_PLATFORM_NULL
+        // without the null platform (GLFW < 3.4) headless falls back to a hidden window, which still needs a display such as Xvfb
+        if (headless && glfwPlatformSupported(GLFW_PLATFORM_NULL))
+            glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    #endif
         if (!glfwInit())
             return "Failed to initialize GLFW";
 
         glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
-        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-        GLFWwindow* glfw_window = glfwCreateWindow((int)(1280), (int)(800), "Visual", nullptr, nullptr);
+        GLFWwindow* glfw_window = create_window();
         if (glfw_window == nullptr)
             return "Failed to create GLFW window";
 
         IMGUI_CHECKVERSION();
         ImGui::CreateContext();
         window = std::shared_ptr<GLFWwindow>(glfw_window, glfwDestroyWindow);
-        if (!ImGui_ImplGlfw_InitForOpenGL(glfw_window, true))
+        if (!headless && !ImGui_ImplGlfw_InitForOpenGL(glfw_window, true))
         {
             window.reset();
             return "Failed to initialize ImGui for GLFW";
         }
         glfwMakeContextCurrent(glfw_window);
-        glfwShowWindow(glfw_window);
-        glfwSwapInterval(1);
+        if (!headless)
+        {
+            glfwShowWindow(glfw_window);
+            glfwSwapInterval(1);
+        }
 
-        if (!gladLoadGL())
+        // EGL and OSMesa entry points are not in the system libGL, load through the context
+        if (headless ? !gladLoadGLLoader((GLADloadproc)glfwGetProcAddress) : !gladLoadGL())
             return "Failed to initialize GLAD";
-        auto glsl_version = "#version 460";
+        auto glsl_version = headless ? "#version 330" : "#version 460";
         if (!ImGui_ImplOpenGL3_Init(glsl_version))
             return "Failed to initialize ImGui for OpenGL3";
         const GLubyte* version = glGetString(GL_VERSION);
         SPDLOG_INFO("OpenGL Version: {}", (const char*)version);
+        if (headless)
+        {
+            if (auto err = create_framebuffer(); err != nullptr)
+                return err;
+            SPDLOG_INFO("OpenGL Renderer: {}", (const char*)glGetString(GL_RENDERER));
+        }
 
         ImGui::StyleColorsLight();
         ImGuiIO& io = ImGui::GetIO();
         io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard; // Enable Keyboard Controls
         io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;  // Enable Gamepad Controls
         io.IniFilename = nullptr;                             // disable imgui.ini
-        io.Fonts->AddFontFromFileTTF("c:\\Windows\\Fonts\\msyh.ttc", 20.0f, nullptr, io.Fonts->GetGlyphRangesChineseFull());
+        if (std::error_code ec; std::filesystem::exists("c:\\Windows\\Fonts\\msyh.ttc", ec))
+            io.Fonts->AddFontFromFileTTF("c:\\Windows\\Fonts\\msyh.ttc", 20.0f, nullptr, io.Fonts->GetGlyphRangesChineseFull());
 
-        std::function<void()> task;
-        while (initialize_queue.try_pop(task) && task)
-            task();
+        initialize_queue.run_all();
         return nullptr;
     }
 
+    // glfwPostEmptyEvent is only valid between glfwInit and glfwTerminate, ready guards that window
+    void wake(bool force = false)
+    {
+        if (!force && !waiting)
+            return;
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        if (ready)
+            glfwPostEmptyEvent();
+    }
+
+    // Returns whether the next frame is active; false means the idle timeout elapsed without anything to draw.
+    // ImGui needs a couple of frames after an input to settle hover and layout, so active frames are followed by settle_frames more
+    bool wait_events(std::chrono::steady_clock::time_point previous, int& settle)
+    {
+        using clock = std::chrono::steady_clock;
+        if (headless)
+            return true;
+        if (!on_demand)
+        {
+            glfwPollEvents();
+            return true;
+        }
+        bool requested = redraw_requested.exchange(false) || settle > 0;
+        if (!requested)
+        {
+            waiting = true;
+            // rechecked after publishing waiting so that a concurrent request either is seen here or posts an empty event
+            if (!redraw_requested.exchange(false) && main_queue.empty() && running)
+            {
+                double idle_fps = max_idle_fps;
+                if (idle_fps > 0)
+                {
+                    double remaining = 1.0 / idle_fps - std::chrono::duration<double>(clock::now() - previous).count();
+                    if (remaining > 0)
+                        glfwWaitEventsTimeout(remaining);
+                    else
+                        glfwPollEvents();
+                }
+                else
+                    glfwWaitEvents();
+                double idle_interval = idle_fps > 0 ? 1.0 / idle_fps : 0;
+                requested = redraw_requested.exchange(false) || !main_queue.empty() || idle_fps <= 0 ||
+                            std::chrono::duration<double>(clock::now() - previous).count() < idle_interval;
+            }
+            else
+                requested = true;
+            waiting = false;
+        }
+        else
+            glfwPollEvents();
+        constexpr int settle_frames = 2;
+        settle = requested ? (settle > 0 ? settle - 1 : settle_frames) : 0;
+        return requested;
+    }
+
     void render_loop()
     {
+        using clock = std::chrono::steady_clock;
+        auto to_ms = [](clock::duration duration) { return std::chrono::duration<double, std::milli>(duration).count(); };
+        auto previous = clock::now();
+        int settle = 0;
         while (running)
         {
-            glfwPollEvents();
-            if (glfwWindowShouldClose(window.get()))
-                break;
-            if (glfwGetWindowAttrib(window.get(), GLFW_ICONIFIED) != 0)
+            bool active = wait_events(previous, settle);
+            if (!headless)
             {
-                ImGui_ImplGlfw_Sleep(10);
-                continue;
+                if (glfwWindowShouldClose(window.get()))
+                    break;
+                if (glfwGetWindowAttrib(window.get(), GLFW_ICONIFIED) != 0)
+                {
+                    ImGui_ImplGlfw_Sleep(10);
+                    continue;
+                }
             }
+            auto frame_begin = clock::now();
 
-            std::function<void()> task;
-            while (main_queue.try_pop(task) && task)
-                task();
+            run_main_tasks();
 
             ImGui_ImplOpenGL3_NewFrame();
-            ImGui_ImplGlfw_NewFrame();
+            if (headless)
+            {
+                ImGuiIO& io = ImGui::GetIO();
+                io.DisplaySize = ImVec2((float)options.width, (float)options.height);
+                io.DeltaTime = options.delta_time;
+            }
+            else
+                ImGui_ImplGlfw_NewFrame();
             ImGui::NewFrame();
 
             render_window();
 
             // Rendering
             ImGui::Render();
-            int display_w, display_h;
-            glfwGetFramebufferSize(window.get(), &display_w, &display_h);
+            auto update_end = clock::now();
+            int display_w = options.width, display_h = options.height;
+            if (!headless)
+                glfwGetFramebufferSize(window.get(), &display_w, &display_h);
             glViewport(0, 0, display_w, display_h);
             glClearColor(0.45f, 0.55f, 0.60f, 1.00f);
             glClear(GL_COLOR_BUFFER_BIT);
             ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+            if (headless)
+                glFinish();
+            auto render_end = clock::now();
+            if (headless && options.readback)
+                read_back();
+            auto readback_end = clock::now();
+
+            if (!headless)
+                glfwSwapBuffers(window.get());
 
-            glfwSwapBuffers(window.get());
+            {
+                std::lock_guard<std::mutex> lock(frame_mutex);
+                timing.frame++;
+                timing.update_ms = to_ms(update_end - frame_begin);
+                timing.render_ms = to_ms(render_end - update_end);
+                timing.readback_ms = to_ms(readback_end - render_end);
+                timing.frame_ms = to_ms(frame_begin - previous);
+                (active ? timing.active_frames : timing.idle_frames)++;
+            }
+            previous = frame_begin;
+            if (headless && options.max_fps > 0)
+                std::this_thread::sleep_until(frame_begin + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / options.max_fps)));
         }
     }
 
+    void run_main_tasks()
+    {
+        using clock = std::chrono::steady_clock;
+        double budget = task_budget_ms;
+        auto begin = clock::now();
+        auto deadline = budget > 0 ? begin + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double, std::milli>(budget)) : clock::time_point::max();
+        auto drain = main_queue.run(deadline);
+        if (drain.tasks == 0)
+            return;
+        auto to_ms = [](clock::duration duration) { return std::chrono::duration<double, std::milli>(duration).count(); };
+        std::lock_guard<std::mutex> lock(frame_mutex);
+        tasks.executed += drain.tasks;
+        tasks.last_drain_tasks = drain.tasks;
+        tasks.last_drain_ms = to_ms(clock::now() - begin);
+        tasks.last_drain_max_latency_ms = to_ms(drain.max_latency);
+        tasks.last_drain_mean_latency_ms = to_ms(drain.total_latency) / (double)drain.tasks;
+    }
+
+    // GL rows start at the bottom, flipped while copying into the published frame
+    void read_back()
+    {
+        size_t stride = (size_t)options.width * 4;
+        readback_pixels.resize(stride * options.height);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glReadPixels(0, 0, options.width, options.height, GL_RGBA, GL_UNSIGNED_BYTE, readback_pixels.data());
+
+        std::lock_guard<std::mutex> lock(frame_mutex);
+        latest_frame.frame = timing.frame + 1;
+        latest_frame.width = options.width;
+        latest_frame.height = options.height;
+        latest_frame.rgba.resize(readback_pixels.size());
+        for (int y = 0; y < options.height; y++)
+            std::copy_n(readback_pixels.data() + stride * (options.height - 1 - y), stride, latest_frame.rgba.data() + stride * y);
+    }
+
     void render_destroy()
     {
-        std::function<void()> task;
-        while (destroy_queue.try_pop(task) && task)
-            task();
+        destroy_queue.run_all();
         ImGui_ImplOpenGL3_Shutdown();
-        ImGui_ImplGlfw_Shutdown();
+        if (!headless)
+            ImGui_ImplGlfw_Shutdown();
+        if (framebuffer != 0)
+        {
+            glDeleteFramebuffers(1, &framebuffer);
+            glDeleteRenderbuffers(1, &colorbuffer);
+            framebuffer = colorbuffer = 0;
+        }
         if (window)
             window.reset();
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex);
+            ready = false;
+        }
         glfwTerminate();
         ImGui::DestroyContext();
     }
     void render_window()
     {
-        std::lock_guard<std::mutex> lock(main_render_mutex);
-        if (main_render_func)
-            main_render_func();
+        auto func = main_render_func.load(std::memory_order_acquire);
+        if (func && *func)
+            (*func)();
     }
 };
 
@@ -207,62 +818,178 @@ void runtime_visualizer::initialize(bool sync_wait)
 {
     if (impl->running)
         return;
+    if (!impl->headless && std::getenv("RUNTIME_VISUALIZER_HEADLESS") != nullptr)
+        impl->headless = true;
 
     auto latch = sync_wait ? std::make_shared<std::latch>(1) : nullptr;
 
+    // open before the thread starts so that tasks submitted right after an asynchronous initialize are kept
+    impl->main_queue.open();
     impl->render_thread = std::thread([this, latch]() {
         impl->running = true;
+        impl->render_thread_id = std::this_thread::get_id();
         set_current_thread_description("User Visualization Thread");
         if (auto err = impl->render_initialize(); err != nullptr)
         {
             SPDLOG_ERROR("Visualization initialization error: {}", err);
+            // there is no GL context to run them in, the waiting callers are failed instead
+            impl->main_queue.close();
+            impl->main_queue.cancel_all();
             impl->running = false;
+            impl->render_thread_id = std::thread::id();
             latch ? latch->count_down() : void();
             return;
         }
+        impl->ready = true;
         latch ? latch->count_down() : void();
         impl->render_loop();
+        impl->main_queue.close();
+        impl->main_queue.run_all();
         impl->render_destroy();
+        impl->render_thread_id = std::thread::id();
         impl->running = false;
     });
     latch ? latch->wait() : void();
 }
+void runtime_visualizer::initialize_headless(bool sync_wait)
+{
+    initialize_headless(headless_options{}, sync_wait);
+}
+void runtime_visualizer::initialize_headless(const headless_options& options, bool sync_wait)
+{
+    if (impl->running)
+        return;
+    impl->headless = true;
+    impl->options = options;
+    impl->options.width = std::max(impl->options.width, 1);
+    impl->options.height = std::max(impl->options.height, 1);
+    initialize(sync_wait);
+}
 void runtime_visualizer::destroy()
 {
     if (impl->running)
+    {
         impl->running = false;
+        impl->wake(true);
+    }
     if (impl->render_thread.joinable())
         impl->render_thread.join();
 }
-void runtime_visualizer::register_initialize(std::function<void()> func)
+void runtime_visualizer::register_initialize(task_t func)
 {
-    impl->initialize_queue.push(func);
+    impl->initialize_queue.push(std::move(func));
 }
-void runtime_visualizer::register_destroy(std::function<void()> func)
+void runtime_visualizer::register_destroy(task_t func)
 {
-    impl->destroy_queue.push(func);
+    impl->destroy_queue.push(std::move(func));
 }
 void runtime_visualizer::main_render(std::function<void()> func)
 {
-    std::lock_guard<std::mutex> lock(impl->main_render_mutex);
-    impl->main_render_func = func;
+    auto published = func ? std::make_shared<const std::function<void()>>(std::move(func)) : nullptr;
+    impl->main_render_func.store(std::move(published), std::memory_order_release);
+    request_redraw();
 }
-void runtime_visualizer::main_enqueue(std::function<void()> func)
+bool runtime_visualizer::main_enqueue(task_t func)
 {
-    impl->main_queue.push(func);
+    if (!impl->main_queue.push(std::move(func)))
+        return false;
+    impl->wake();
+    return true;
 }
-void runtime_visualizer::main_execute(std::function<void()> func)
+void runtime_visualizer::main_execute(task_t func)
 {
-    std::latch promise(1);
-    impl->main_queue.push([&promise, func]() {
+    // waiting on our own queue from the render thread would never return
+    if (on_render_thread())
+    {
         func();
-        promise.count_down();
+        return;
+    }
+    struct waiter_t
+    {
+        std::latch done{ 1 };
+        std::exception_ptr error = nullptr;
+        bool ran = false;
+    };
+    // counts down when the queued task is destroyed, whether it ran, was rejected or was dropped
+    struct notify_t
+    {
+        waiter_t* waiter;
+        explicit notify_t(waiter_t* waiter) : waiter(waiter) {}
+        notify_t(notify_t&& other) noexcept : waiter(std::exchange(other.waiter, nullptr)) {}
+        ~notify_t()
+        {
+            if (waiter)
+                waiter->done.count_down();
+        }
+    };
+    waiter_t waiter;
+    main_enqueue([notify = notify_t(&waiter), &func]() {
+        notify.waiter->ran = true;
+        try
+        {
+            func();
+        }
+        catch (...)
+        {
+            notify.waiter->error = std::current_exception();
+        }
     });
-    promise.wait();
+    waiter.done.wait();
+    if (!waiter.ran)
+        throw std::runtime_error("runtime_visualizer: render thread is not running");
+    if (waiter.error)
+        std::rethrow_exception(waiter.error);
+}
+bool runtime_visualizer::on_render_thread() const
+{
+    return impl->render_thread_id.load() == std::this_thread::get_id();
 }
 void runtime_visualizer::wait_exit()
 {
     if (impl->render_thread.joinable())
         impl->render_thread.join();
 }
+void runtime_visualizer::set_redraw_options(const redraw_options& options)
+{
+    impl->max_idle_fps = std::max(options.max_idle_fps, 0.0);
+    impl->on_demand = options.on_demand;
+    // leaving on-demand mode or shortening the idle interval must not wait for the old timeout
+    impl->wake();
+}
+void runtime_visualizer::request_redraw()
+{
+    impl->redraw_requested = true;
+    impl->wake();
+}
+void runtime_visualizer::set_task_budget(double milliseconds)
+{
+    impl->task_budget_ms = std::max(milliseconds, 0.0);
+}
+runtime_visualizer::task_stats runtime_visualizer::main_task_stats() const
+{
+    std::lock_guard<std::mutex> lock(impl->frame_mutex);
+    auto stats = impl->tasks;
+    stats.depth = impl->main_queue.size();
+    return stats;
+}
+bool runtime_visualizer::headless() const
+{
+    return impl->headless;
+}
+runtime_visualizer::frame_timing runtime_visualizer::last_frame_timing() const
+{
+    std::lock_guard<std::mutex> lock(impl->frame_mutex);
+    return impl->timing;
+}
+bool runtime_visualizer::read_frame(frame_image& image) const
+{
+    std::lock_guard<std::mutex> lock(impl->frame_mutex);
+    if (impl->latest_frame.frame <= image.frame)
+        return false;
+    image.frame = impl->latest_frame.frame;
+    image.width = impl->latest_frame.width;
+    image.height = impl->latest_frame.height;
+    image.rgba.assign(impl->latest_frame.rgba.begin(), impl->latest_frame.rgba.end());
+    return true;
+}
 #endif
\ No newline at end of file
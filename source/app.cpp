@@ -1,13 +1,15 @@
 #include <fmt/format.h>
 #include <rfl.hpp>
 
-struct node
-{
-    ~node() = default;
-    std::string describe() const { return "I am a node"; }
-};
+#include "flow-mat.hpp"
+#include "flow-profile-panel.hpp"
+#include "flow.hpp"
+
+#include "factorys-concurrent.hpp"
+#include "factorys-palette.hpp"
+#include "factorys-pool.hpp"
 
-#include "factorys.hpp"
+REGISTER_POOLED_NODE("临时/节点/静态创建", node);
 
 #define RUNTIME_VISUALIZER_IMPLEMENTATION
 #include <runtime-visualizer.hpp>
@@ -25,39 +27,73 @@ int main(int argc, char* argv[])
 
     std::cout << "Hello, World! 测试中文" << std::endl;
 
-    node_factorys node_fs;
+    concurrent_node_factorys node_fs;
+    node_fs.update([](node_factorys& groups) { return static_node_factorys::register_to(groups); });
     node_fs.register_group_from_absolute_path("tmp/创建", []() -> std::shared_ptr<node> { return nullptr; });
     node_fs.register_group_from_absolute_path("临时/节点/创建", []() -> std::shared_ptr<node> { return nullptr; });
     node_fs.register_group_from_absolute_path("创建", []() -> std::shared_ptr<node> { return nullptr; });
+    // 注册完成后在这里发布一次，渲染线程取快照时不必再拷贝
+    node_fs.publish();
+    factory_search_palette<node_factorys::functor> node_palette;
+    flow_memo_cache node_memo(256ull << 20);
+    flow_profiler node_profiler;
+    flow_profile_panel node_profile_panel;
     runtime_visualizer viz;
     viz.initialize();
+    // 界面无变化时只按 10 FPS 刷新，节点耗时面板仍能跟上新记录
+    viz.set_redraw_options({ .on_demand = true, .max_idle_fps = 10.0 });
     viz.main_render([&]() {
         ImGui::Begin("Hello, world!");
         ImGui::Text("测试中文");
         ImGui::End();
 
-        if (node_fs.root_factory->size() == 0)
+        auto node_groups = node_fs.snapshot();
+        if (node_groups->empty())
         {
             ImGui::Text("没有可用的节点工厂");
         }
         else
         {
-            node_fs.for_each(
-                [](std::vector<std::string> stack, node_factorys::stack_status status, bool menu_status, std::shared_ptr<factory_group<std::function<std::shared_ptr<node>()>>> groups) {
+            node_groups->visit_pruned(
+                [](std::span<const std::string_view>, node_factorys::stack_status status, bool menu_status, node_factorys::group group) {
                     if (menu_status == false)
                         return false;
                     if (status == node_factorys::stack_status::begin)
-                        return ImGui::BeginMenu(stack.back().c_str());
+                        return ImGui::BeginMenu(group.c_name());
                     else if (status == node_factorys::stack_status::content)
                     {
-                        if (ImGui::MenuItem(stack.back().c_str()))
-                            groups->factory_opt.value()();
+                        if (ImGui::MenuItem(group.c_name()))
+                            group.factory()();
                     }
                     else if (status == node_factorys::stack_status::end)
                         ImGui::EndMenu();
                     return false;
                 });
+
+            ImGui::Begin("节点搜索");
+            if (auto factory = node_palette.render(*node_groups))
+                (*factory)();
+            ImGui::End();
         }
+
+        ImGui::Begin("节点池");
+        node_pool_registry::for_each([](std::string_view name, slab_pool::stats_t stats) {
+            ImGui::Text("%.*s: %zu / %zu (峰值 %zu, 块 %zu 字节, slab %zu)", static_cast<int>(name.size()), name.data(), stats.in_use, stats.capacity, stats.peak, stats.block_size, stats.slabs);
+        });
+        auto mat_stats = mat_buffer_pool::instance().stats();
+        ImGui::Text("图像缓冲: 使用 %zu 块 %.1f MiB, 空闲 %zu 块 %.1f MiB, 峰值 %.1f MiB", mat_stats.buffers_in_use, mat_stats.bytes_in_use / 1048576.0, mat_stats.buffers_free, mat_stats.bytes_free / 1048576.0,
+                    mat_stats.peak_bytes_total / 1048576.0);
+        ImGui::End();
+
+        ImGui::Begin("结果缓存");
+        auto memo_stats = node_memo.stats();
+        ImGui::Text("命中 %zu / 未命中 %zu / 淘汰 %zu", memo_stats.hits, memo_stats.misses, memo_stats.evictions);
+        ImGui::Text("%zu 项, %.1f / %.1f MiB", memo_stats.entries, memo_stats.bytes / 1048576.0, memo_stats.budget / 1048576.0);
+        ImGui::End();
+
+        ImGui::Begin("节点耗时");
+        node_profile_panel.render(node_profiler);
+        ImGui::End();
     });
 
     viz.wait_exit();
@@ -0,0 +1,315 @@
+#pragma once
+#include "factorys.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#if defined(_WIN32) || defined(_WIN64)
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+    #undef WIN32_LEAN_AND_MEAN
+    #undef NOMINMAX
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+// 只读映射整个文件，映射失败时 data() 为空
+class mapped_file
+{
+    const std::byte* view = nullptr;
+    size_t view_size = 0;
+
+public:
+    mapped_file() = default;
+    explicit mapped_file(const std::filesystem::path& path) { open(path); }
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+    ~mapped_file() { close(); }
+
+public:
+    const std::byte* data() const { return view; }
+    size_t size() const { return view_size; }
+
+    bool open(const std::filesystem::path& path)
+    {
+        close();
+#if defined(_WIN32) || defined(_WIN64)
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER file_size = {};
+        HANDLE mapping = nullptr;
+        if (GetFileSizeEx(file, &file_size) && file_size.QuadPart != 0)
+            mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (mapping == nullptr)
+            return false;
+        view = static_cast<const std::byte*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        CloseHandle(mapping);
+        if (view == nullptr)
+            return false;
+        view_size = static_cast<size_t>(file_size.QuadPart);
+#else
+        int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file < 0)
+            return false;
+        struct stat file_stat = {};
+        void* mapping = MAP_FAILED;
+        if (fstat(file, &file_stat) == 0 && file_stat.st_size != 0)
+            mapping = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        ::close(file);
+        if (mapping == MAP_FAILED)
+            return false;
+        view = static_cast<const std::byte*>(mapping);
+        view_size = static_cast<size_t>(file_stat.st_size);
+#endif
+        return true;
+    }
+    void close()
+    {
+        if (view == nullptr)
+            return;
+#if defined(_WIN32) || defined(_WIN64)
+        UnmapViewOfFile(view);
+#else
+        munmap(const_cast<std::byte*>(view), view_size);
+#endif
+        view = nullptr;
+        view_size = 0;
+    }
+};
+
+// 工厂目录缓存的文件布局：文件头之后依次是节点表、菜单计划与名字区，全部为本机字节序的定长记录，映射后可直接遍历。
+// 节点编号与工厂编号沿用写出时工厂树中的编号，工厂编号即注册顺序；fingerprint 由调用方给出，
+// 用来判断缓存是否对应当前的工厂集合（例如插件清单的哈希或版本号）
+namespace factory_cache_format
+{
+    constexpr char magic[8] = { 'C', 'F', 'V', 'C', 'A', 'C', 'H', 'E' };
+    constexpr uint32_t version = 1;
+    constexpr uint32_t npos = static_cast<uint32_t>(-1);
+
+    struct header_t
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t header_size;
+        uint64_t fingerprint;
+        uint32_t node_count;
+        uint32_t record_count;
+        uint32_t name_bytes;
+        uint32_t factory_count;
+    };
+    struct node_t
+    {
+        uint32_t name_offset;
+        uint32_t name_size;
+        uint32_t factory_id;
+        uint32_t child_count;
+    };
+    struct record_t
+    {
+        uint32_t status;
+        uint32_t node;
+        uint32_t skip;
+        uint32_t depth;
+    };
+} // namespace factory_cache_format
+
+// 把工厂树的结构（名字、层级、菜单计划、工厂编号）写成缓存文件；工厂本身不写出，读取时按编号延迟绑定
+template <class F> bool write_factory_cache(factory_group_manager<F>& groups, const std::filesystem::path& path, uint64_t fingerprint)
+{
+    namespace format = factory_cache_format;
+    using manager = factory_group_manager<F>;
+    auto& trie = groups.groups();
+    auto& records = groups.plan();
+    auto names = trie.name_arena();
+
+    format::header_t header = {};
+    std::memcpy(header.magic, format::magic, sizeof(header.magic));
+    header.version = format::version;
+    header.header_size = sizeof(header);
+    header.fingerprint = fingerprint;
+    header.node_count = static_cast<uint32_t>(trie.size() + 1);
+    header.record_count = static_cast<uint32_t>(records.size());
+    header.name_bytes = static_cast<uint32_t>(names.size());
+
+    std::vector<format::node_t> nodes(header.node_count);
+    for (uint32_t id = 0; id < header.node_count; id++)
+    {
+        auto& node = trie.node(id);
+        auto factory_id = node.factory_index == manager::storage::npos ? format::npos : node.factory_index;
+        nodes[id] = { node.name_offset, node.name_size, factory_id, node.child_count };
+        if (factory_id != format::npos)
+            header.factory_count = std::max(header.factory_count, factory_id + 1);
+    }
+    std::vector<format::record_t> plan(records.size());
+    for (size_t i = 0; i < records.size(); i++)
+        plan[i] = { static_cast<uint32_t>(records[i].status), records[i].id, records[i].skip, records[i].depth };
+
+    auto temporary = path;
+    temporary += ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(nodes.data()), static_cast<std::streamsize>(nodes.size() * sizeof(format::node_t)));
+        file.write(reinterpret_cast<const char*>(plan.data()), static_cast<std::streamsize>(plan.size() * sizeof(format::record_t)));
+        file.write(names.data(), static_cast<std::streamsize>(names.size()));
+        file.close();
+        if (!file)
+        {
+            std::error_code ignored;
+            std::filesystem::remove(temporary, ignored);
+            return false;
+        }
+    }
+    // 先写临时文件再替换，避免其它进程映射到写了一半的缓存；替换失败时同样删掉临时文件
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error)
+    {
+        std::error_code ignored;
+        std::filesystem::remove(temporary, ignored);
+    }
+    return !error;
+}
+
+// 映射后的工厂目录：遍历直接读取文件中的菜单计划，名字直接指向映射区；工厂在第一次被取用时
+// 通过 binder(工厂编号) 绑定并缓存。遍历与绑定都复用内部缓冲区，只应在同一线程中使用
+template <class F> class mapped_factory_catalogue
+{
+public:
+    using functor = F;
+    using stack_status = typename factory_group_manager<F>::stack_status;
+    using binder_t = std::function<functor(uint32_t factory_id)>;
+
+    class group
+    {
+        mapped_factory_catalogue* catalogue = nullptr;
+        uint32_t id = 0;
+
+    public:
+        group() = default;
+        group(mapped_factory_catalogue& catalogue, uint32_t id) : catalogue(&catalogue), id(id) {}
+
+    public:
+        uint32_t index() const { return id; }
+        std::string_view name() const { return catalogue->name(id); }
+        const char* c_name() const { return catalogue->name(id).data(); }
+        bool is_sub_group() const { return catalogue->nodes[id].child_count != 0; }
+        bool is_has_factory() const { return catalogue->nodes[id].factory_id != factory_cache_format::npos; }
+        uint32_t factory_id() const { return catalogue->nodes[id].factory_id; }
+        const functor& factory() const { return catalogue->bind(catalogue->nodes[id].factory_id); }
+    };
+
+private:
+    mapped_file file;
+    std::span<const factory_cache_format::node_t> nodes;
+    std::span<const factory_cache_format::record_t> records;
+    const char* names = nullptr;
+    binder_t binder;
+    std::vector<std::optional<functor>> bound;
+    std::vector<std::string_view> visit_path;
+
+public:
+    mapped_factory_catalogue() = default;
+    mapped_factory_catalogue(const mapped_factory_catalogue&) = delete;
+    mapped_factory_catalogue& operator=(const mapped_factory_catalogue&) = delete;
+
+public:
+    bool is_open() const { return file.data() != nullptr; }
+    bool empty() const { return records.empty(); }
+    size_t size() const { return nodes.empty() ? 0 : nodes.size() - 1; }
+
+    // 文件不存在、格式不符、fingerprint 不一致或越界时返回 false，调用方应重新构建工厂树并写出缓存
+    bool open(const std::filesystem::path& path, uint64_t fingerprint, binder_t factory_binder)
+    {
+        namespace format = factory_cache_format;
+        close();
+        if (!file.open(path))
+            return false;
+
+        format::header_t header = {};
+        if (file.size() < sizeof(header))
+            return close(), false;
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, format::magic, sizeof(header.magic)) != 0 || header.version != format::version || header.header_size != sizeof(header) || header.fingerprint != fingerprint)
+            return close(), false;
+        uint64_t expected = uint64_t(header.header_size) + uint64_t(header.node_count) * sizeof(format::node_t) + uint64_t(header.record_count) * sizeof(format::record_t) + header.name_bytes;
+        // 每个节点至多挂一个工厂，factory_count 超过节点数的文件必然损坏；节点数已由文件大小约束，
+        // 之后按 factory_count 分配的绑定表也就不会超出文件规模
+        if (header.node_count == 0 || file.size() != expected || header.factory_count > header.node_count)
+            return close(), false;
+
+        auto data = file.data() + header.header_size;
+        nodes = { reinterpret_cast<const format::node_t*>(data), header.node_count };
+        records = { reinterpret_cast<const format::record_t*>(data + header.node_count * sizeof(format::node_t)), header.record_count };
+        names = reinterpret_cast<const char*>(data + header.node_count * sizeof(format::node_t) + header.record_count * sizeof(format::record_t));
+
+        // 校验只做一次顺序扫描，之后的遍历不再检查边界
+        for (auto& node : nodes.subspan(1))
+            if (uint64_t(node.name_offset) + node.name_size >= header.name_bytes || names[node.name_offset + node.name_size] != '\0' || (node.factory_id != format::npos && node.factory_id >= header.factory_count))
+                return close(), false;
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            auto& record = records[i];
+            if (record.node == 0 || record.node >= nodes.size() || record.status > static_cast<uint32_t>(stack_status::end) || record.depth == 0 || record.depth > nodes.size())
+                return close(), false;
+            if (record.status == static_cast<uint32_t>(stack_status::begin) && (record.skip <= i || record.skip >= records.size()))
+                return close(), false;
+        }
+
+        binder = std::move(factory_binder);
+        bound.assign(header.factory_count, std::nullopt);
+        return true;
+    }
+    void close()
+    {
+        file.close();
+        nodes = {};
+        records = {};
+        names = nullptr;
+        bound.clear();
+        visit_path.clear();
+    }
+
+    std::string_view name(uint32_t id) const { return { names + nodes[id].name_offset, nodes[id].name_size }; }
+    const functor& bind(uint32_t factory_id)
+    {
+        auto& slot = bound[factory_id];
+        if (!slot)
+            slot.emplace(binder(factory_id));
+        return *slot;
+    }
+
+    // 与 factory_group_manager::visit_pruned 相同的回调约定，begin 返回 false 时跳过整个子树
+    template <class Pred> void visit_pruned(Pred&& pred)
+    {
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            auto& record = records[i];
+            if (visit_path.size() < record.depth)
+                visit_path.resize(record.depth);
+            visit_path[record.depth - 1] = name(record.node);
+            auto status = static_cast<stack_status>(record.status);
+            bool menu_status = pred(std::span<const std::string_view>(visit_path.data(), record.depth), status, true, group(*this, record.node));
+            if (status == stack_status::begin && !menu_status)
+                i = record.skip;
+        }
+    }
+};
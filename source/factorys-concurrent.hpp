@@ -0,0 +1,94 @@
+#pragma once
+#include "factorys.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+
+// 多线程注册、渲染线程读取不可变快照：写入方在锁内修改私有的主副本，修改在下一次 publish 或 snapshot 时
+// 合并成一个新快照并通过原子 shared_ptr 发布，连续 N 次注册只拷贝一次而不是 N 次。
+// 读取方持有的快照在其生命周期内保持一致，快照的菜单计划与搜索索引在发布前已构建好
+template <class F> class concurrent_factory_group_manager
+{
+public:
+    using functor = F;
+    using manager = factory_group_manager<functor>;
+    using snapshot_ptr = std::shared_ptr<const manager>;
+
+private:
+    manager master;
+    std::mutex master_mutex;
+    std::atomic<bool> publishing = false;
+    std::atomic<uint64_t> master_version = 0;
+    std::atomic<uint64_t> published_version = 0;
+    std::atomic<snapshot_ptr> current = std::make_shared<const manager>();
+
+public:
+    // 有未发布的修改时先发布；其它线程正在发布时不等待，直接返回当前快照，由该线程带上这些修改
+    snapshot_ptr snapshot()
+    {
+        if (published_version.load(std::memory_order_seq_cst) < master_version.load(std::memory_order_seq_cst))
+            publish();
+        return current.load(std::memory_order_acquire);
+    }
+    uint64_t version() const { return published_version.load(std::memory_order_acquire); }
+
+public:
+    bool register_group(const std::vector<std::string>& paths, functor factory)
+    {
+        return update([&](manager& groups) { return groups.register_group(paths, std::move(factory)); });
+    }
+    bool register_group_from_absolute_path(std::string_view absolute_path, functor factory)
+    {
+        return update([&](manager& groups) { return groups.register_group_from_absolute_path(absolute_path, std::move(factory)); });
+    }
+    void register_group_from_factorys(std::vector<std::pair<std::string, functor>> factorys)
+    {
+        update([&](manager& groups) { groups.register_group_from_factorys(std::move(factorys)); });
+    }
+    void clear()
+    {
+        update([](manager& groups) { groups.clear(); });
+    }
+
+    // 在写锁内对主副本做任意修改，只记下版本号而不拷贝；修改在下一次 publish 或 snapshot 时生效
+    template <class Func> auto update(Func&& func)
+    {
+        std::lock_guard<std::mutex> lock(master_mutex);
+        master_version.fetch_add(1, std::memory_order_seq_cst);
+        return func(master);
+    }
+
+    // 把主副本至今的全部修改发布为新快照。注册线程在一批注册之后调用，可避免由渲染线程在 snapshot 中承担拷贝与构建。
+    // 同一时刻只有一个线程拷贝，其它线程发现标志已被占用时直接返回；持有者清除标志后重新比较版本号，
+    // 标志与版本号都是 seq_cst，返回的线程看到的修改一定会被持有者看到并发布
+    void publish()
+    {
+        while (published_version.load(std::memory_order_seq_cst) < master_version.load(std::memory_order_seq_cst))
+        {
+            if (publishing.exchange(true, std::memory_order_seq_cst))
+                return;
+            struct publishing_guard
+            {
+                std::atomic<bool>* flag;
+                ~publishing_guard() { flag->store(false, std::memory_order_seq_cst); }
+            } guard{ &publishing };
+
+            std::shared_ptr<manager> next;
+            uint64_t next_version = 0;
+            {
+                std::lock_guard<std::mutex> lock(master_mutex);
+                next = std::make_shared<manager>(master);
+                next_version = master_version.load(std::memory_order_seq_cst);
+            }
+            next->prepare();
+            current.store(std::move(next), std::memory_order_release);
+            published_version.store(next_version, std::memory_order_seq_cst);
+        }
+    }
+};
+
+struct node;
+using concurrent_node_factorys = concurrent_factory_group_manager<std::function<std::shared_ptr<node>()>>;
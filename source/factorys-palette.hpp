@@ -0,0 +1,92 @@
+#pragma once
+#include <imgui.h>
+
+#include "factorys.hpp"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// 搜索面板：在 main_render 回调中调用 render，输入框内容变化或管理器内容变化（revision 改变）时才重新查询，
+// 方向键选择、回车或点击创建节点
+template <class F> class factory_search_palette
+{
+public:
+    using manager = factory_group_manager<F>;
+    using functor = F;
+
+private:
+    char query[256] = {};
+    std::string last_query;
+    // 缓存的结果持有指向管理器内部的视图，只有同一对象且内容未变时才能复用；地址可能被新的快照复用，单看地址不够
+    const manager* last_groups = nullptr;
+    uint64_t last_revision = 0;
+    std::vector<typename manager::search_match> matches;
+    int selected = 0;
+    size_t top_k = 50;
+
+public:
+    factory_search_palette() = default;
+    explicit factory_search_palette(size_t top_k) : top_k(top_k) {}
+
+public:
+    void reset()
+    {
+        query[0] = '\0';
+        last_query.clear();
+        last_groups = nullptr;
+        last_revision = 0;
+        matches.clear();
+        selected = 0;
+    }
+
+    // 普通管理器：先补建搜索索引再查询
+    const functor* render(manager& groups)
+    {
+        groups.prepare();
+        return render(std::as_const(groups));
+    }
+    // 返回被选中的工厂，未选中时返回 nullptr；groups 需在本帧内保持有效，并且已经 prepare（如 concurrent 管理器的快照）
+    const functor* render(const manager& groups)
+    {
+        IM_ASSERT(groups.index().ready() && "factory_search_palette: 管理器未 prepare，搜索索引尚未建立");
+        if (ImGui::IsWindowAppearing())
+            ImGui::SetKeyboardFocusHere();
+        ImGui::SetNextItemWidth(-1);
+        bool submit = ImGui::InputTextWithHint("##factory_search", "搜索节点", query, sizeof(query), ImGuiInputTextFlags_EnterReturnsTrue);
+
+        if (last_groups != &groups || last_revision != groups.revision() || last_query != query)
+        {
+            last_groups = &groups;
+            last_revision = groups.revision();
+            last_query = query;
+            matches = groups.search(last_query, top_k);
+            selected = 0;
+        }
+        if (matches.empty())
+        {
+            if (!last_query.empty())
+                ImGui::TextDisabled("没有匹配的节点");
+            return nullptr;
+        }
+
+        if (ImGui::IsKeyPressed(ImGuiKey_DownArrow))
+            selected = (selected + 1) % static_cast<int>(matches.size());
+        if (ImGui::IsKeyPressed(ImGuiKey_UpArrow))
+            selected = (selected + static_cast<int>(matches.size()) - 1) % static_cast<int>(matches.size());
+
+        bool navigated = ImGui::IsKeyPressed(ImGuiKey_DownArrow, false) || ImGui::IsKeyPressed(ImGuiKey_UpArrow, false);
+        const functor* chosen = nullptr;
+        for (int i = 0; i < static_cast<int>(matches.size()); i++)
+        {
+            ImGui::PushID(i);
+            if (ImGui::Selectable(matches[i].path.data(), i == selected) || (submit && i == selected))
+                chosen = groups.groups().factory(matches[i].id);
+            if (i == selected && navigated)
+                ImGui::SetScrollHereY();
+            ImGui::PopID();
+        }
+        return chosen;
+    }
+};
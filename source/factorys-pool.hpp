@@ -0,0 +1,210 @@
+#pragma once
+#include "factorys-static.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string_view>
+#include <typeinfo>
+#include <vector>
+
+// 固定块大小的 slab 池：按 slab 成批向全局分配器申请内存，空闲块串成侵入式链表，分配与回收都是 O(1)；
+// slab 在池的生命周期内不归还，稳态下不再调用全局分配器。块大小在第一次分配时确定
+class slab_pool
+{
+public:
+    struct stats_t
+    {
+        size_t block_size = 0;
+        size_t capacity = 0;
+        size_t in_use = 0;
+        size_t peak = 0;
+        size_t slabs = 0;
+    };
+
+private:
+    struct free_block
+    {
+        free_block* next;
+    };
+    static constexpr size_t first_slab_blocks = 16;
+    static constexpr size_t max_slab_blocks = 4096;
+
+    mutable std::mutex pool_mutex;
+    size_t block_size = 0;
+    size_t block_align = alignof(free_block);
+    size_t next_slab_blocks = first_slab_blocks;
+    size_t reserved_blocks = 0;
+    free_block* free_list = nullptr;
+    std::vector<void*> slabs;
+    stats_t counters;
+
+public:
+    slab_pool() = default;
+    slab_pool(const slab_pool&) = delete;
+    slab_pool& operator=(const slab_pool&) = delete;
+    ~slab_pool()
+    {
+        for (auto slab : slabs)
+            ::operator delete(slab, std::align_val_t(block_align));
+    }
+
+public:
+    stats_t stats() const
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        return counters;
+    }
+
+    // 块大小与对齐在第一次分配时确定且之后不变；能拿到池中指针的一方必然发生在配置之后，可以不加锁读取
+    bool fits(size_t size, size_t align) const { return size <= block_size && align <= block_align; }
+
+    // 放不进池块的请求返回 nullptr，由调用方退回全局分配器
+    void* allocate(size_t size, size_t align)
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        configure(size, align);
+        if (!fits(size, align))
+            return nullptr;
+        if (free_list == nullptr)
+            grow(next_slab_blocks);
+
+        auto block = free_list;
+        free_list = block->next;
+        counters.in_use++;
+        counters.peak = std::max(counters.peak, counters.in_use);
+        return block;
+    }
+    void deallocate(void* pointer)
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        auto block = static_cast<free_block*>(pointer);
+        block->next = free_list;
+        free_list = block;
+        counters.in_use--;
+    }
+    // 预先备好至少 block_count 个块，之后用量不超过该值时不会再申请 slab；块大小尚未确定时推迟到第一次分配
+    void reserve(size_t block_count)
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        if (block_size == 0)
+            reserved_blocks = std::max(reserved_blocks, block_count);
+        else if (counters.capacity < block_count)
+            grow(block_count - counters.capacity);
+    }
+
+private:
+    void configure(size_t size, size_t align)
+    {
+        if (block_size != 0)
+            return;
+        block_align = std::max(align, alignof(free_block));
+        block_size = (std::max(size, sizeof(free_block)) + block_align - 1) / block_align * block_align;
+        counters.block_size = block_size;
+        if (reserved_blocks != 0)
+            grow(reserved_blocks);
+    }
+    void grow(size_t block_count)
+    {
+        auto slab = static_cast<std::byte*>(::operator new(block_count * block_size, std::align_val_t(block_align)));
+        slabs.push_back(slab);
+        for (size_t i = block_count; i-- > 0;)
+        {
+            auto block = reinterpret_cast<free_block*>(slab + i * block_size);
+            block->next = free_list;
+            free_list = block;
+        }
+        counters.capacity += block_count;
+        counters.slabs++;
+        next_slab_blocks = std::min(std::max(next_slab_blocks, block_count) * 2, max_slab_blocks);
+    }
+};
+
+// 所有节点池的登记表，只在每种类型第一次使用池时登记一次，供界面展示占用情况
+class node_pool_registry
+{
+public:
+    struct record
+    {
+        std::string_view name;
+        const slab_pool* pool;
+    };
+
+private:
+    static inline std::mutex registry_mutex;
+    static inline std::vector<record> records;
+
+public:
+    static void add(std::string_view name, const slab_pool* pool)
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        records.push_back({ name, pool });
+    }
+    template <class Func> static void for_each(Func&& func)
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        for (auto& record : records)
+            func(record.name, record.pool->stats());
+    }
+};
+
+// 每种节点类型一个池；池对象有意不析构，静态析构之后才释放的节点仍能安全归还
+template <class T> class node_pool
+{
+public:
+    static slab_pool& instance()
+    {
+        static slab_pool* pool = [] {
+            auto created = new slab_pool();
+            node_pool_registry::add(typeid(T).name(), created);
+            return created;
+        }();
+        return *pool;
+    }
+    static slab_pool::stats_t stats() { return instance().stats(); }
+    static void reserve(size_t count) { instance().reserve(count); }
+};
+
+// std::allocate_shared 使用的分配器：控制块与节点对象放在同一个池块中，最后一个引用释放时经由
+// 分配器的 deallocate 归还到池，起到自定义删除器的作用，且不需要额外的控制块分配
+template <class U, class T = U> struct node_pool_allocator
+{
+    using value_type = U;
+    template <class V> struct rebind
+    {
+        using other = node_pool_allocator<V, T>;
+    };
+
+    node_pool_allocator() = default;
+    template <class V> node_pool_allocator(const node_pool_allocator<V, T>&) noexcept {}
+
+    U* allocate(size_t n)
+    {
+        if (n == 1)
+            if (auto pointer = node_pool<T>::instance().allocate(sizeof(U), alignof(U)))
+                return static_cast<U*>(pointer);
+        return static_cast<U*>(::operator new(n * sizeof(U), std::align_val_t(alignof(U))));
+    }
+    void deallocate(U* pointer, size_t n) noexcept
+    {
+        auto& pool = node_pool<T>::instance();
+        if (n == 1 && pool.fits(sizeof(U), alignof(U)))
+            pool.deallocate(pointer);
+        else
+            ::operator delete(pointer, std::align_val_t(alignof(U)));
+    }
+
+    template <class V> bool operator==(const node_pool_allocator<V, T>&) const noexcept { return true; }
+};
+
+struct node;
+// 池化的节点工厂，可直接作为函数指针交给工厂管理器或静态注册表
+template <class T, class Base = node> std::shared_ptr<Base> make_pooled_node()
+{
+    return std::allocate_shared<T>(node_pool_allocator<T>());
+}
+
+// REGISTER_POOLED_NODE("图像/滤波/高斯", gaussian_node)：与 REGISTER_NODE 相同，但节点从该类型的池中分配
+#define REGISTER_POOLED_NODE(path, type) REGISTER_STATIC_FACTORY(static_node_factorys, path, &make_pooled_node<type>)
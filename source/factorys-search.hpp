@@ -0,0 +1,335 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// 工厂完整路径的模糊搜索索引：路径按 UTF-8 解码为码点，去掉 '/' 后建立 1/2/3 元组倒排表，
+// 元组直接用码点拼成 64 位键（每个码点 21 位），不会产生哈希冲突；另有两张表只收录起始于某级名字开头、
+// 落在最后一级名字内的元组，用来在评分前算出得分上限。条目只增不删，倒排表按条目顺序增量补建，
+// 完整路径以 '\0' 结尾存放，可直接交给 ImGui
+class factory_search_index
+{
+public:
+    using index_t = uint32_t;
+    static constexpr index_t npos = static_cast<index_t>(-1);
+
+    struct match
+    {
+        index_t id;
+        int32_t score;
+        std::string_view path;
+    };
+
+private:
+    static constexpr uint32_t codepoint_mask = 0x1fffff;
+    static constexpr uint32_t segment_start = 0x80000000u;
+    static constexpr size_t max_query_size = 256;
+
+    enum gram_kind
+    {
+        any_gram,
+        leading_gram,
+        last_segment_gram,
+        gram_kind_count
+    };
+
+    struct entry_t
+    {
+        index_t id;
+        uint32_t text_offset;
+        uint32_t text_size;
+        uint32_t codepoint_offset;
+        uint32_t codepoint_size;
+        uint32_t last_segment;
+    };
+
+    std::vector<entry_t> entries;
+    std::string texts;
+    // 高位标记该码点是否为某一级名字的首字符
+    std::vector<uint32_t> codepoints;
+    std::vector<uint32_t> node_entries;
+    // 元组键到倒排表的开放寻址哈希表；键本身由码点拼成，乘一个奇数常量取高位即可散列均匀
+    class posting_table
+    {
+        std::vector<uint64_t> keys;
+        std::vector<std::vector<uint32_t>> lists;
+        std::vector<uint32_t> slots = std::vector<uint32_t>(16, npos);
+        uint32_t shift = 60;
+
+        size_t slot_of(uint64_t key) const { return static_cast<size_t>((key * 0x9e3779b97f4a7c15ull) >> shift); }
+
+    public:
+        void clear()
+        {
+            keys.clear();
+            lists.clear();
+            slots.assign(16, npos);
+            shift = 60;
+        }
+        const std::vector<uint32_t>* find(uint64_t key) const
+        {
+            for (auto slot = slot_of(key);; slot = (slot + 1) & (slots.size() - 1))
+            {
+                if (slots[slot] == npos)
+                    return nullptr;
+                if (keys[slots[slot]] == key)
+                    return &lists[slots[slot]];
+            }
+        }
+        std::vector<uint32_t>& operator[](uint64_t key)
+        {
+            auto slot = slot_of(key);
+            for (; slots[slot] != npos; slot = (slot + 1) & (slots.size() - 1))
+                if (keys[slots[slot]] == key)
+                    return lists[slots[slot]];
+
+            slots[slot] = static_cast<uint32_t>(lists.size());
+            keys.push_back(key);
+            lists.emplace_back();
+            if (lists.size() * 2 > slots.size())
+                rehash();
+            return lists.back();
+        }
+
+    private:
+        void rehash()
+        {
+            slots.assign(slots.size() * 2, npos);
+            shift--;
+            for (uint32_t i = 0; i < keys.size(); i++)
+            {
+                auto slot = slot_of(keys[i]);
+                while (slots[slot] != npos)
+                    slot = (slot + 1) & (slots.size() - 1);
+                slots[slot] = i;
+            }
+        }
+    };
+    posting_table postings[gram_kind_count];
+    uint32_t indexed = 0;
+
+public:
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+    void clear()
+    {
+        entries.clear();
+        texts.clear();
+        codepoints.clear();
+        node_entries.clear();
+        for (auto& kind : postings)
+            kind.clear();
+        indexed = 0;
+    }
+    bool contains(index_t id) const { return id < node_entries.size() && node_entries[id] != npos; }
+
+    // 从 UTF-8 中解码一个码点，非法字节按单字节原值处理；ASCII 字母统一转为小写
+    static uint32_t decode(std::string_view text, size_t& pos)
+    {
+        auto lead = static_cast<unsigned char>(text[pos++]);
+        if (lead < 0x80)
+            return (lead >= 'A' && lead <= 'Z') ? lead + ('a' - 'A') : lead;
+        size_t extra = lead >= 0xf0 ? 3 : lead >= 0xe0 ? 2 : lead >= 0xc0 ? 1 : 0;
+        if (extra == 0 || pos + extra > text.size())
+            return lead;
+        uint32_t codepoint = lead & (0x3f >> extra);
+        for (size_t i = 0; i < extra; i++)
+        {
+            auto next = static_cast<unsigned char>(text[pos + i]);
+            if ((next & 0xc0) != 0x80)
+                return lead;
+            codepoint = (codepoint << 6) | (next & 0x3f);
+        }
+        pos += extra;
+        return codepoint & codepoint_mask;
+    }
+    // 不足三个码点的元组用 0x1fffff 补齐，该值超出 Unicode 范围，不会与真实码点相同
+    static uint64_t gram_key(std::span<const uint32_t> grams)
+    {
+        uint64_t key = 0;
+        for (size_t i = 0; i < 3; i++)
+            key = (key << 21) | (i < grams.size() ? (grams[i] & codepoint_mask) : codepoint_mask);
+        return key;
+    }
+
+public:
+    // segments 为路径各级名字；同一节点只会被索引一次，重复注册时保持原有条目
+    template <class Segments> void insert(index_t id, const Segments& segments)
+    {
+        if (contains(id))
+            return;
+        if (id >= node_entries.size())
+            node_entries.resize(static_cast<size_t>(id) + 1, npos);
+
+        entry_t entry{ id, static_cast<uint32_t>(texts.size()), 0, static_cast<uint32_t>(codepoints.size()), 0, 0 };
+        for (std::string_view segment : segments)
+        {
+            if (segment.empty())
+                continue;
+            if (texts.size() != entry.text_offset)
+                texts.push_back('/');
+            texts.append(segment);
+            entry.last_segment = static_cast<uint32_t>(codepoints.size()) - entry.codepoint_offset;
+            for (size_t pos = 0, first = 1; pos < segment.size(); first = 0)
+                codepoints.push_back(decode(segment, pos) | (first ? segment_start : 0));
+        }
+        entry.text_size = static_cast<uint32_t>(texts.size()) - entry.text_offset;
+        texts.push_back('\0');
+        entry.codepoint_size = static_cast<uint32_t>(codepoints.size()) - entry.codepoint_offset;
+
+        node_entries[id] = static_cast<uint32_t>(entries.size());
+        entries.push_back(entry);
+    }
+    // node_count 为节点编号的上界，用于预留节点到条目的映射
+    void reserve(size_t entry_count, size_t text_bytes, size_t node_count)
+    {
+        node_entries.reserve(node_count);
+        entries.reserve(entries.size() + entry_count);
+        texts.reserve(texts.size() + text_bytes);
+        codepoints.reserve(codepoints.size() + text_bytes);
+    }
+
+    // 倒排表在 build 时才为新增条目补建，注册路径上只记录路径本身；search 只检索已建好倒排表的条目
+    bool ready() const { return indexed == entries.size(); }
+    void build()
+    {
+        for (; indexed < entries.size(); indexed++)
+        {
+            auto& entry = entries[indexed];
+            auto append = [entry_index = indexed](std::vector<uint32_t>& list) {
+                if (list.empty() || list.back() != entry_index)
+                    list.push_back(entry_index);
+            };
+            std::span<const uint32_t> chars(codepoints.data() + entry.codepoint_offset, entry.codepoint_size);
+            for (size_t n = 1; n <= 3; n++)
+                for (size_t i = 0; i + n <= chars.size(); i++)
+                {
+                    auto key = gram_key(chars.subspan(i, n));
+                    append(postings[any_gram][key]);
+                    if (chars[i] & segment_start)
+                        append(postings[leading_gram][key]);
+                    if (i >= entry.last_segment)
+                        append(postings[last_segment_gram][key]);
+                }
+        }
+    }
+
+    // 返回按得分降序的前 top_k 个结果；查询长度不少于三个码点时允许约三分之一的三元组缺失以容忍错字，
+    // path 指向索引内部的字符串区，在索引被修改前有效
+    std::vector<match> search(std::string_view query, size_t top_k) const
+    {
+        std::vector<match> results;
+        std::vector<uint32_t> chars;
+        for (size_t pos = 0; pos < query.size() && chars.size() < max_query_size;)
+            if (auto codepoint = decode(query, pos); codepoint != '/' && codepoint != ' ')
+                chars.push_back(codepoint);
+        if (chars.empty() || top_k == 0 || indexed == 0)
+            return results;
+
+        std::vector<uint64_t> keys;
+        auto n = std::min<size_t>(chars.size(), 3);
+        for (size_t i = 0; i + n <= chars.size(); i++)
+            keys.push_back(gram_key(std::span<const uint32_t>(chars).subspan(i, n)));
+        auto first_key = keys.front();
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+        std::vector<const std::vector<uint32_t>*> lists;
+        lists.reserve(keys.size());
+        for (auto key : keys)
+            if (auto list = postings[any_gram].find(key))
+                lists.push_back(list);
+        auto min_hits = keys.size() - keys.size() / 3;
+        if (lists.size() < min_hits)
+            return results;
+        std::sort(lists.begin(), lists.end(), [](auto a, auto b) { return a->size() < b->size(); });
+
+        // 每个条目的低位记录命中的元组数，高两位记录查询首个元组是否出现在名字开头、最后一级名字内，
+        // 完整命中必然以首个元组开头，因此这两位缺失时对应的加分不可能出现；评分后清零以免重复评分
+        constexpr uint16_t leading_flag = 0x8000;
+        constexpr uint16_t last_segment_flag = 0x4000;
+        constexpr uint16_t hit_mask = 0x3fff;
+        std::vector<uint16_t> hits(indexed, 0);
+        for (auto list : lists)
+            for (auto candidate : *list)
+                hits[candidate]++;
+        const std::vector<uint32_t>* leading = nullptr;
+        if ((leading = postings[leading_gram].find(first_key)))
+        {
+            for (auto candidate : *leading)
+                hits[candidate] |= leading_flag;
+        }
+        if (auto last_segment = postings[last_segment_gram].find(first_key))
+            for (auto candidate : *last_segment)
+                hits[candidate] |= last_segment_flag;
+
+        auto worse = [](const match& a, const match& b) { return a.score != b.score ? a.score > b.score : a.path < b.path; };
+        auto collect = [&](const std::vector<uint32_t>& list) {
+            for (auto candidate : list)
+            {
+                auto state = hits[candidate];
+                size_t hit = state & hit_mask;
+                if (hit < min_hits)
+                    continue;
+                hits[candidate] = 0;
+
+                // 堆满后先用得分上限剪枝，避免对不可能进入前 top_k 的条目做完整评分
+                auto& entry = entries[candidate];
+                if (results.size() == top_k)
+                {
+                    auto limit = static_cast<int32_t>(hit * 100 / keys.size()) - static_cast<int32_t>(entry.codepoint_size);
+                    if (hit == keys.size())
+                        limit += 100 + ((state & leading_flag) ? 50 : 0) + ((state & last_segment_flag) ? 25 : 0);
+                    if (limit < results.front().score)
+                        continue;
+                }
+                match current{ entry.id, score(entry, chars, hit, keys.size()), std::string_view(texts.data() + entry.text_offset, entry.text_size) };
+                if (results.size() < top_k)
+                {
+                    results.push_back(current);
+                    std::push_heap(results.begin(), results.end(), worse);
+                }
+                else if (worse(current, results.front()))
+                {
+                    std::pop_heap(results.begin(), results.end(), worse);
+                    results.back() = current;
+                    std::push_heap(results.begin(), results.end(), worse);
+                }
+            }
+        };
+
+        // 先评分首个元组位于名字开头的条目，它们的得分上限最高，能尽早抬高堆顶使其余条目被剪枝；
+        // 命中 min_hits 个元组的条目必然出现在最短的 (元组数 - min_hits + 1) 个倒排表之一中
+        if (leading)
+            collect(*leading);
+        auto sources = std::min(keys.size() - min_hits + 1, lists.size());
+        for (size_t source = 0; source < sources; source++)
+            collect(*lists[source]);
+        std::sort_heap(results.begin(), results.end(), worse);
+        return results;
+    }
+
+private:
+    // 元组命中率为基础分；整段连续命中加分，命中位置在某级名字开头、落在最后一级名字内再依次加分，路径越短越靠前
+    int32_t score(const entry_t& entry, std::span<const uint32_t> query, size_t hits, size_t grams) const
+    {
+        std::span<const uint32_t> chars(codepoints.data() + entry.codepoint_offset, entry.codepoint_size);
+        auto score = static_cast<int32_t>(hits * 100 / grams) - static_cast<int32_t>(chars.size());
+        int32_t bonus = -1;
+        for (size_t i = 0; i + query.size() <= chars.size() && bonus < 75; i++)
+        {
+            if ((chars[i] & codepoint_mask) != query[0])
+                continue;
+            size_t k = 1;
+            while (k < query.size() && (chars[i + k] & codepoint_mask) == query[k])
+                k++;
+            if (k == query.size())
+                bonus = std::max(bonus, ((chars[i] & segment_start) ? 50 : 0) + (i >= entry.last_segment ? 25 : 0));
+        }
+        return bonus < 0 ? score : score + 100 + bonus;
+    }
+};
@@ -0,0 +1,117 @@
+#pragma once
+#include "factorys.hpp"
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string_view>
+
+// 编译期切分的工厂路径：字面量在编译期按 '/' 拆成各级名字，空名字被跳过，运行期不再解析字符串
+template <size_t N> struct static_factory_path
+{
+    char text[N] = {};
+    size_t offsets[N] = {};
+    size_t sizes[N] = {};
+    size_t count = 0;
+
+    consteval static_factory_path(const char (&path)[N])
+    {
+        for (size_t i = 0; i < N; i++)
+            text[i] = path[i];
+        size_t begin = 0;
+        for (size_t i = 0; i < N; i++)
+        {
+            if (i + 1 != N && path[i] != '/')
+                continue;
+            if (i != begin)
+            {
+                offsets[count] = begin;
+                sizes[count] = i - begin;
+                count++;
+            }
+            begin = i + 1;
+        }
+    }
+};
+
+// 各级名字的 string_view 表，指向模板参数对象内的字符，整张表在编译期确定
+template <static_factory_path path> struct static_factory_segments
+{
+    static_assert(path.count != 0, "static factory path must contain at least one name");
+    static constexpr std::array<std::string_view, path.count> value = [] {
+        std::array<std::string_view, path.count> segments;
+        for (size_t i = 0; i < path.count; i++)
+            segments[i] = std::string_view(path.text + path.offsets[i], path.sizes[i]);
+        return segments;
+    }();
+};
+
+// 静态注册表：每个 REGISTER_* 宏定义一个 registrar，在静态初始化阶段把自身记录挂到侵入式链表尾部，
+// 不做任何堆分配；工厂以函数指针保存，合并进管理器时构造的 std::function 也只占用其内部缓冲区
+template <class R> class static_factory_registry
+{
+public:
+    using result = R;
+    using pointer = R (*)();
+
+    struct entry
+    {
+        std::span<const std::string_view> segments;
+        pointer factory = nullptr;
+        entry* next = nullptr;
+    };
+
+private:
+    static inline entry* head = nullptr;
+    static inline entry** tail = &head;
+    static inline size_t count = 0;
+    static inline size_t segment_count = 0;
+    static inline size_t name_bytes = 0;
+
+public:
+    class registrar
+    {
+        entry record;
+
+    public:
+        registrar(std::span<const std::string_view> segments, pointer factory) : record{ segments, factory }
+        {
+            *tail = &record;
+            tail = &record.next;
+            count++;
+            segment_count += segments.size();
+            for (auto segment : segments)
+                name_bytes += segment.size() + 1;
+        }
+        registrar(const registrar&) = delete;
+        registrar& operator=(const registrar&) = delete;
+    };
+
+public:
+    static size_t size() { return count; }
+    static const entry* begin() { return head; }
+
+    // 按注册顺序合并到管理器，返回成功注册的条数；同一路径重复注册时后者覆盖前者
+    template <class F> static size_t register_to(factory_group_manager<F>& groups)
+    {
+        groups.reserve(count, segment_count, name_bytes);
+        size_t registered = 0;
+        for (auto record = head; record != nullptr; record = record->next)
+            registered += groups.register_group_from_segments(record->segments, F(record->factory));
+        return registered;
+    }
+};
+
+#define FACTORYS_STATIC_CONCAT_IMPL(a, b) a##b
+#define FACTORYS_STATIC_CONCAT(a, b) FACTORYS_STATIC_CONCAT_IMPL(a, b)
+
+// REGISTER_STATIC_FACTORY(registry, "一级/二级/名字", 工厂函数)：工厂函数需可转换为 registry::pointer
+#define REGISTER_STATIC_FACTORY(registry, path, factory) \
+    static registry::registrar FACTORYS_STATIC_CONCAT(static_factory_registrar_, __COUNTER__) { static_factory_segments<path>::value, factory }
+
+struct node;
+using static_node_factorys = static_factory_registry<std::shared_ptr<node>>;
+
+// REGISTER_NODE("图像/滤波/高斯", gaussian_node)：type 需为 node 的完整类型且可默认构造
+#define REGISTER_NODE(path, type) REGISTER_STATIC_FACTORY(static_node_factorys, path, +[]() -> std::shared_ptr<node> { return std::make_shared<type>(); })
@@ -1,33 +1,201 @@
 #pragma once
+#include "factorys-search.hpp"
+
 #include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
 #include <functional>
 #include <memory>
-#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
-template <class F> class factory_group
+// 工厂树的存储：节点连续存放，名字以 '\0' 结尾统一放在一块字符串区，子节点通过 (parent, name) 哈希索引
+template <class F> class factory_trie
 {
 public:
     using functor = F;
-    using group_ptr = std::shared_ptr<factory_group<functor>>;
-    using name_group = std::pair<std::string, group_ptr>;
-    using groups = std::vector<std::pair<std::string, std::shared_ptr<factory_group<functor>>>>;
-    using groups_ptr = std::shared_ptr<groups>;
+    using index_t = uint32_t;
+    static constexpr index_t npos = static_cast<index_t>(-1);
+
+    struct node_t
+    {
+        uint64_t hash = 0;
+        index_t parent = npos;
+        index_t name_offset = 0;
+        index_t name_size = 0;
+        index_t first_child = npos;
+        index_t last_child = npos;
+        index_t next_sibling = npos;
+        index_t child_count = 0;
+        index_t factory_index = npos;
+    };
+
+private:
+    std::vector<node_t> nodes;
+    std::string names;
+    std::vector<functor> factories;
+    std::vector<index_t> slots;
+
+public:
+    factory_trie() { clear(); }
+
+public:
+    static constexpr index_t root() { return 0; }
+    static uint64_t hash_of(index_t parent, std::string_view name)
+    {
+        uint64_t hash = 0xcbf29ce484222325ull ^ (static_cast<uint64_t>(parent) * 0x9e3779b97f4a7c15ull);
+        for (auto c : name)
+        {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+public:
+    void clear()
+    {
+        nodes.assign(1, node_t{});
+        names.clear();
+        factories.clear();
+        slots.assign(16, npos);
+    }
+    void reserve(size_t node_count, size_t name_bytes)
+    {
+        nodes.reserve(node_count + 1);
+        names.reserve(name_bytes);
+        factories.reserve(node_count);
+        size_t slot_count = slots.size();
+        while (slot_count < (node_count + 1) * 2)
+            slot_count *= 2;
+        if (slot_count != slots.size())
+            rehash(slot_count);
+    }
+
+    size_t size() const { return nodes.size() - 1; }
+    size_t name_bytes() const { return names.size(); }
+    std::string_view name_arena() const { return names; }
+    bool empty() const { return nodes.size() == 1; }
+    const node_t& node(index_t id) const { return nodes[id]; }
+    std::string_view name(index_t id) const { return { names.data() + nodes[id].name_offset, nodes[id].name_size }; }
+    const functor* factory(index_t id) const { return nodes[id].factory_index == npos ? nullptr : &factories[nodes[id].factory_index]; }
+
+    index_t find_child(index_t parent, std::string_view name) const
+    {
+        auto hash = hash_of(parent, name);
+        auto mask = slots.size() - 1;
+        for (auto slot = hash & mask;; slot = (slot + 1) & mask)
+        {
+            auto id = slots[slot];
+            if (id == npos)
+                return npos;
+            if (nodes[id].hash == hash && nodes[id].parent == parent && this->name(id) == name)
+                return id;
+        }
+    }
+    index_t emplace_child(index_t parent, std::string_view name)
+    {
+        auto hash = hash_of(parent, name);
+        auto mask = slots.size() - 1;
+        auto slot = hash & mask;
+        for (;; slot = (slot + 1) & mask)
+        {
+            auto id = slots[slot];
+            if (id == npos)
+                break;
+            if (nodes[id].hash == hash && nodes[id].parent == parent && this->name(id) == name)
+                return id;
+        }
+        return insert_child(parent, name, hash, slot);
+    }
+    // 调用方保证 parent 下没有同名子节点，跳过名字比较，只寻找空槽
+    index_t append_child(index_t parent, std::string_view name)
+    {
+        auto hash = hash_of(parent, name);
+        auto mask = slots.size() - 1;
+        auto slot = hash & mask;
+        while (slots[slot] != npos)
+            slot = (slot + 1) & mask;
+        return insert_child(parent, name, hash, slot);
+    }
+    void set_factory(index_t id, functor factory)
+    {
+        auto& factory_index = nodes[id].factory_index;
+        if (factory_index != npos)
+        {
+            factories[factory_index] = std::move(factory);
+            return;
+        }
+        factory_index = static_cast<index_t>(factories.size());
+        factories.push_back(std::move(factory));
+    }
 
+private:
+    index_t insert_child(index_t parent, std::string_view name, uint64_t hash, size_t slot)
+    {
+        auto id = static_cast<index_t>(nodes.size());
+        node_t& child = nodes.emplace_back();
+        child.hash = hash;
+        child.parent = parent;
+        child.name_offset = static_cast<index_t>(names.size());
+        child.name_size = static_cast<index_t>(name.size());
+        names.append(name);
+        names.push_back('\0');
+
+        node_t& parent_node = nodes[parent];
+        if (parent_node.last_child == npos)
+            parent_node.first_child = id;
+        else
+            nodes[parent_node.last_child].next_sibling = id;
+        parent_node.last_child = id;
+        parent_node.child_count++;
+
+        slots[slot] = id;
+        if (nodes.size() * 2 > slots.size())
+            rehash(slots.size() * 2);
+        return id;
+    }
+    void rehash(size_t slot_count)
+    {
+        slots.assign(slot_count, npos);
+        auto mask = slot_count - 1;
+        for (index_t id = 1; id < nodes.size(); id++)
+        {
+            auto slot = nodes[id].hash & mask;
+            while (slots[slot] != npos)
+                slot = (slot + 1) & mask;
+            slots[slot] = id;
+        }
+    }
+};
+
+template <class F> class factory_group
+{
 public:
-    std::optional<functor> factory_opt = std::nullopt;
-    groups_ptr sub_groups = std::make_shared<groups>();
+    using functor = F;
+    using storage = factory_trie<functor>;
+    using index_t = typename storage::index_t;
+
+private:
+    const storage* trie = nullptr;
+    index_t id = storage::npos;
 
 public:
     factory_group() = default;
-    factory_group(std::optional<functor> factory_opt, groups_ptr sub_groups) : factory_opt(factory_opt), sub_groups(sub_groups) {}
+    factory_group(const storage& trie, index_t id) : trie(&trie), id(id) {}
 
 public:
-    bool is_sub_group() { return !sub_groups->empty(); }
-    bool is_has_factory() { return factory_opt.has_value(); }
-    bool is_empty() { return sub_groups->empty() && !factory_opt.has_value(); }
-    void factory_to_sub_group(std::string name) { sub_groups->push_back(std::make_pair(name, std::make_shared<factory_group<functor>>(factory_opt, std::make_shared<groups>()))); }
+    index_t index() const { return id; }
+    std::string_view name() const { return trie->name(id); }
+    const char* c_name() const { return trie->name(id).data(); }
+    bool is_sub_group() const { return trie->node(id).child_count != 0; }
+    bool is_has_factory() const { return trie->factory(id) != nullptr; }
+    bool is_empty() const { return !is_sub_group() && !is_has_factory(); }
+    const functor& factory() const { return *trie->factory(id); }
 };
 
 template <class F> class factory_group_manager
@@ -35,180 +203,375 @@ template <class F> class factory_group_manager
 public:
     factory_group_manager() = default;
     ~factory_group_manager() = default;
+    // 菜单计划与遍历缓冲区持有指向名字区的视图，拷贝或移动后需要重建
+    factory_group_manager(const factory_group_manager& other) : trie(other.trie), search_index(other.search_index) {}
+    factory_group_manager(factory_group_manager&& other) noexcept : trie(std::move(other.trie)), search_index(std::move(other.search_index)) { other.clear(); }
+    factory_group_manager& operator=(const factory_group_manager& other)
+    {
+        if (this != &other)
+            assign(storage(other.trie), factory_search_index(other.search_index));
+        return *this;
+    }
+    factory_group_manager& operator=(factory_group_manager&& other) noexcept
+    {
+        if (this != &other)
+        {
+            assign(std::move(other.trie), std::move(other.search_index));
+            other.clear();
+        }
+        return *this;
+    }
 
 public:
     using functor = F;
-    using factory_groups = std::vector<std::pair<std::string, std::shared_ptr<factory_group<functor>>>>;
-    std::shared_ptr<factory_groups> root_factory = std::make_shared<factory_groups>();
+    using storage = factory_trie<functor>;
+    using group = factory_group<functor>;
+    using index_t = typename storage::index_t;
+    using search_match = factory_search_index::match;
+
+    enum class stack_status
+    {
+        begin,
+        content,
+        end
+    };
+
+    // 菜单计划：树展开后的 begin/content/end 线性记录，begin 记录的 skip 指向与之配对的 end，
+    // 每条记录的完整路径预先展开在 plan_paths 中
+    struct plan_record
+    {
+        stack_status status;
+        index_t id;
+        uint32_t skip;
+        uint32_t path_offset;
+        uint32_t depth;
+    };
 
 private:
-    bool register_group_to_groups(std::string path, std::vector<std::string> paths, const std::string& name, std::shared_ptr<factory_groups> groups, functor factory)
+    storage trie;
+    factory_search_index search_index;
+    std::vector<std::string_view> visit_path;
+    std::vector<plan_record> menu_plan;
+    std::vector<std::string_view> plan_paths;
+    bool menu_plan_dirty = true;
+    // 全局递增，每次修改（以及拷贝、移动得到的新实例）取一个新值，不同实例之间也不会重复
+    static inline std::atomic<uint64_t> revision_counter = 0;
+    uint64_t current_revision = ++revision_counter;
+
+    void touch()
     {
-        auto groups_it = groups->begin();
+        menu_plan_dirty = true;
+        current_revision = ++revision_counter;
+    }
 
-        if (path != "")
-        {
-            groups_it = std::find_if(groups->begin(), groups->end(), [path](auto& group) { return group.first == path; });
-            if (groups_it == groups->end())
-            {
-                groups->push_back(std::make_pair(path, std::make_shared<factory_group<functor>>()));
-                groups_it = groups->end() - 1;
-            }
-            groups = groups_it->second->sub_groups;
-        }
-        if (paths.size() == 0)
-        {
-            // 在该组进行插入，
-            // 1.如果是新建组，就设置为factory_opt，
-            // 2.如果已经有factory_opt但是不是sub_group就转化为sub_group再插入sub_gorup
-            // 3.如果是sub_group就插入
-            if (groups_it->second->is_empty())
-            {
-                groups_it->second->factory_opt = factory;
-                return true;
-            }
+public:
+    const storage& groups() const { return trie; }
+    // 内容标识：搜索结果、名字视图等派生数据只在 revision 不变时有效，用它而不是对象地址判断是否需要重新查询
+    uint64_t revision() const { return current_revision; }
+    bool empty() const { return trie.empty(); }
+    const factory_search_index& index() const { return search_index; }
+    void clear()
+    {
+        trie.clear();
+        search_index.clear();
+        touch();
+    }
 
-            if (groups_it->second->is_has_factory())
-                groups_it->second->factory_to_sub_group(groups_it->first);
-            groups_it->second->sub_groups->push_back(std::make_pair(name, std::make_shared<factory_group<functor>>()));
-            groups_it->second->sub_groups->back().second->factory_opt = factory;
+private:
+    void assign(storage&& other, factory_search_index&& other_index)
+    {
+        trie = std::move(other);
+        search_index = std::move(other_index);
+        visit_path.clear();
+        menu_plan.clear();
+        plan_paths.clear();
+        touch();
+    }
 
-            return true;
+public:
+    template <class Func> static void for_each_path_segment(std::string_view absolute_path, Func&& func)
+    {
+        size_t begin = 0;
+        while (begin < absolute_path.size())
+        {
+            auto end = absolute_path.find('/', begin);
+            if (end == std::string_view::npos)
+                end = absolute_path.size();
+            if (end != begin)
+                func(absolute_path.substr(begin, end - begin));
+            begin = end + 1;
         }
+    }
 
-        if (not groups_it->second->is_sub_group() && groups_it->second->is_has_factory())
+    // 同一路径重复注册时覆盖原有工厂；已有工厂的节点再挂子节点时，遍历会把自身工厂作为同名的第一个子项
+    bool register_group(const std::vector<std::string>& paths, functor factory) { return register_group_from_segments(paths, std::move(factory)); }
+    // segments 为已切分好的各级名字（任意可迭代出 string_view 的序列），不做任何字符串解析
+    template <class Segments> bool register_group_from_segments(const Segments& segments, functor factory)
+    {
+        auto id = storage::root();
+        for (std::string_view segment : segments)
+            if (!segment.empty())
+                id = trie.emplace_child(id, segment);
+        if (id == storage::root())
+            return false;
+        trie.set_factory(id, std::move(factory));
+        search_index.insert(id, segments);
+        touch();
+        return true;
+    }
+    // 为即将注册的 factory_count 个工厂预留空间，node_count 与 name_bytes 为其路径的名字总数与总字节数
+    void reserve(size_t factory_count, size_t node_count, size_t name_bytes)
+    {
+        trie.reserve(trie.size() + node_count, trie.name_bytes() + name_bytes);
+        search_index.reserve(factory_count, name_bytes, trie.size() + node_count + 1);
+        // 预留可能搬移名字区与路径文本，菜单计划里的路径视图随之失效，丢弃并在下次 plan() 时重建
+        visit_path.clear();
+        menu_plan.clear();
+        plan_paths.clear();
+        touch();
+    }
+    bool register_group_from_absolute_path(std::string_view absolute_path, functor factory)
+    {
+        auto id = storage::root();
+        for_each_path_segment(absolute_path, [&](std::string_view path) { id = trie.emplace_child(id, path); });
+        if (id == storage::root())
+            return false;
+        trie.set_factory(id, std::move(factory));
+        if (!search_index.contains(id))
         {
-            groups_it->second->factory_to_sub_group(groups_it->first);
+            std::vector<std::string_view> segments;
+            for_each_path_segment(absolute_path, [&](std::string_view path) { segments.push_back(path); });
+            search_index.insert(id, segments);
         }
+        touch();
+        return true;
+    }
 
-        auto next_path = paths[0];
-        paths.erase(paths.begin());
-        return register_group_to_groups(next_path, paths, name, groups, factory);
+    // 按完整路径模糊搜索已注册的工厂，返回得分最高的 top_k 项；倒排表在注册后首次搜索时补建
+    std::vector<search_match> search(std::string_view query, size_t top_k = 20)
+    {
+        search_index.build();
+        return std::as_const(search_index).search(query, top_k);
+    }
+    // const 版本只读取已建好的索引，可在快照上由多个线程同时调用；调用前必须 prepare（快照发布前已做过），
+    // 否则尚未补建的条目不会出现在结果中
+    std::vector<search_match> search(std::string_view query, size_t top_k = 20) const
+    {
+        assert(search_index.ready() && "factory_group_manager::search const 需要先调用 prepare");
+        return search_index.search(query, top_k);
     }
 
-    bool register_groups_to_groups(std::string path, std::vector<std::string> paths, std::shared_ptr<factory_groups> groups, std::shared_ptr<factory_groups> sub_groups)
+    // 批量注册：先把所有路径切分好并一次性预留节点、名字区与哈希槽，再逐条插入；与上一条路径相同的前缀直接复用已定位的节点，
+    // 只对分叉之后的部分查找或插入。sort_by_path 为 true 时先按各级名字逐级排序，共享前缀的路径相邻，
+    // 本批新建节点的子节点也不会再回头出现，可跳过查重直接追加；同级菜单随之按名字排序，否则保持传入顺序。重复路径仍以最后一条为准
+    void register_group_from_factorys(std::vector<std::pair<std::string, functor>> factorys, bool sort_by_path = false)
     {
-        auto groups_it = groups->begin();
+        struct path_range
+        {
+            uint32_t offset;
+            uint32_t size;
+        };
+        std::vector<std::string_view> segments;
+        std::vector<path_range> ranges;
+        ranges.reserve(factorys.size());
+        size_t name_bytes = 0;
+        for (auto& [path, factory] : factorys)
+        {
+            auto offset = static_cast<uint32_t>(segments.size());
+            for_each_path_segment(path, [&](std::string_view segment) {
+                segments.push_back(segment);
+                name_bytes += segment.size() + 1;
+            });
+            ranges.push_back({ offset, static_cast<uint32_t>(segments.size()) - offset });
+        }
+        reserve(factorys.size(), segments.size(), name_bytes);
+
+        auto path_of = [&](uint32_t i) { return std::span<const std::string_view>(segments.data() + ranges[i].offset, ranges[i].size); };
+        std::vector<uint32_t> order(factorys.size());
+        for (uint32_t i = 0; i < order.size(); i++)
+            order[i] = i;
+        if (sort_by_path)
+            std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+                auto lhs = path_of(a);
+                auto rhs = path_of(b);
+                return std::lexicographical_compare(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+            });
 
-        if (path != "")
+        struct path_node
         {
-            groups_it = std::find_if(groups->begin(), groups->end(), [path](auto& group) { return group.first == path; });
-            if (groups_it == groups->end())
+            index_t id;
+            bool created;
+        };
+        std::vector<path_node> path_nodes;
+        std::span<const std::string_view> last_path;
+        for (auto i : order)
+        {
+            auto path = path_of(i);
+            if (path.empty())
+                continue;
+            size_t depth = 0;
+            while (depth < path.size() && depth < last_path.size() && depth < path_nodes.size() && path[depth] == last_path[depth])
+                depth++;
+            path_nodes.resize(depth);
+            for (; depth < path.size(); depth++)
             {
-                groups->push_back(std::make_pair(path, std::make_shared<factory_group<functor>>()));
-                groups_it = groups->end() - 1;
+                auto parent = depth == 0 ? storage::root() : path_nodes[depth - 1].id;
+                bool parent_created = sort_by_path && depth != 0 && path_nodes[depth - 1].created;
+                auto node_count = trie.size();
+                auto id = parent_created ? trie.append_child(parent, path[depth]) : trie.emplace_child(parent, path[depth]);
+                path_nodes.push_back({ id, trie.size() != node_count });
             }
-            groups = groups_it->second->sub_groups;
+            last_path = path;
+
+            auto id = path_nodes.back().id;
+            trie.set_factory(id, std::move(factorys[i].second));
+            search_index.insert(id, path);
         }
-        if (paths.size() == 0)
+        touch();
+    }
+
+    void for_each_group(index_t parent, std::function<bool(std::vector<std::string>, stack_status, bool, group)> pred, std::vector<std::string> stack = {}, bool last_menu_status = true)
+    {
+        for (auto id = trie.node(parent).first_child; id != storage::npos; id = trie.node(id).next_sibling)
         {
-            // 在该组进行插入，
-            // 1.如果是新建组，就设置为factory_opt，
-            // 2.如果已经有factory_opt但是不是sub_group就转化为sub_group再插入sub_gorup
-            // 3.如果是sub_group就插入
-            if (groups_it->second->is_empty())
+            group current(trie, id);
+            stack.emplace_back(trie.name(id));
+            if (!current.is_sub_group())
             {
-                groups_it->second->sub_groups = sub_groups;
-                return true;
+                pred(stack, stack_status::content, last_menu_status, current);
+                stack.pop_back();
+                continue;
+            }
+            auto menu_status = pred(stack, stack_status::begin, last_menu_status, current);
+            if (current.is_has_factory())
+            {
+                stack.emplace_back(trie.name(id));
+                pred(stack, stack_status::content, menu_status, current);
+                stack.pop_back();
             }
+            for_each_group(id, pred, stack, menu_status);
+            pred(stack, stack_status::end, menu_status, current);
+            stack.pop_back();
+        }
+    }
+    void for_each(std::function<bool(std::vector<std::string>, stack_status, bool, group)> pred, std::vector<std::string> stack = {}, bool last_menu_status = true)
+    {
+        for_each_group(storage::root(), pred, stack, last_menu_status);
+    }
 
-            if (groups_it->second->is_has_factory())
-                groups_it->second->factory_to_sub_group(groups_it->first);
-            groups_it->second->sub_groups->push_back(std::make_pair(sub_groups->begin()->first, std::make_shared<factory_group<functor>>()));
-            groups_it->second->sub_groups->back().second->sub_groups = sub_groups;
+    // pred: bool(std::span<const std::string_view> path, stack_status, bool menu_status, group)
+    // path 指向复用的缓冲区，仅在本次回调内有效；遍历过程中不会产生堆分配
+    template <class Pred> void visit(Pred&& pred, bool last_menu_status = true)
+    {
+        visit_path.clear();
+        visit_group(storage::root(), pred, last_menu_status);
+    }
 
-            return true;
+    const std::vector<plan_record>& plan()
+    {
+        if (menu_plan_dirty)
+        {
+            menu_plan.clear();
+            plan_paths.clear();
+            visit_path.clear();
+            build_plan(storage::root());
+            menu_plan_dirty = false;
         }
+        return menu_plan;
+    }
+    // 构建所有只读派生数据（菜单计划与搜索索引），之后 const 的遍历与搜索都不再需要修改管理器
+    void prepare()
+    {
+        plan();
+        search_index.build();
+    }
 
-        if (not groups_it->second->is_sub_group() && groups_it->second->is_has_factory())
+    // 与 visit 相同的回调，但 begin 返回 false 时直接跳过整个子树且不再回调对应的 end，
+    // 开销只与展开的菜单规模相关；菜单计划在注册后首次调用时重建
+    template <class Pred> void visit_pruned(Pred&& pred)
+    {
+        plan();
+        std::as_const(*this).visit_pruned(pred);
+    }
+    // const 版本只读取已构建的菜单计划，可由多个线程同时调用；计划未构建时不产生任何回调
+    template <class Pred> void visit_pruned(Pred&& pred) const
+    {
+        if (menu_plan_dirty)
+            return;
+        for (size_t i = 0; i < menu_plan.size(); i++)
         {
-            groups_it->second->factory_to_sub_group(groups_it->first);
+            auto& record = menu_plan[i];
+            std::span<const std::string_view> path(plan_paths.data() + record.path_offset, record.depth);
+            bool menu_status = pred(path, record.status, true, group(trie, record.id));
+            if (record.status == stack_status::begin && !menu_status)
+                i = record.skip;
         }
-
-        auto next_path = paths[0];
-        paths.erase(paths.begin());
-        return register_node_groups_to_groups(next_path, paths, groups, sub_groups);
     }
 
-public:
-    void register_group(std::shared_ptr<factory_groups> root_groups, const std::vector<std::string>& paths, functor factory)
+private:
+    void push_plan_record(stack_status status, index_t id, size_t path_offset)
     {
-        std::shared_ptr<factory_groups> groups = root_groups;
-        auto paths_copy = paths;
-        auto path = paths_copy[0];
-        auto name = paths.back();
-        paths_copy.erase(paths_copy.begin());
-        register_group_to_groups(path, paths_copy, name, groups, factory);
+        menu_plan.push_back({ status, id, 0, static_cast<uint32_t>(path_offset), static_cast<uint32_t>(visit_path.size()) });
     }
-    void register_group(std::shared_ptr<factory_groups> root_groups, const std::vector<std::string>& paths, std::shared_ptr<factory_groups> sub_groups)
+    size_t push_plan_path()
     {
-        std::shared_ptr<factory_groups> groups = root_groups;
-        auto paths_copy = paths;
-        auto path = paths_copy[0];
-        paths_copy.erase(paths_copy.begin());
-        register_groups_to_groups(path, paths_copy, groups, sub_groups);
+        auto path_offset = plan_paths.size();
+        plan_paths.insert(plan_paths.end(), visit_path.begin(), visit_path.end());
+        return path_offset;
     }
-    void register_group_from_absolute_path(const std::string absolute_path, functor factory)
+    void build_plan(index_t parent)
     {
-        std::vector<std::string> paths;
-        std::string path;
-        for (auto& c : absolute_path)
+        for (auto id = trie.node(parent).first_child; id != storage::npos; id = trie.node(id).next_sibling)
         {
-            if (c == '/')
+            group current(trie, id);
+            visit_path.push_back(trie.name(id));
+            auto path_offset = push_plan_path();
+            if (!current.is_sub_group())
             {
-                if (path != "")
-                    paths.push_back(path);
-                path = "";
+                push_plan_record(stack_status::content, id, path_offset);
+                visit_path.pop_back();
+                continue;
             }
-            else
+            auto begin = menu_plan.size();
+            push_plan_record(stack_status::begin, id, path_offset);
+            if (current.is_has_factory())
             {
-                path += c;
+                visit_path.push_back(trie.name(id));
+                push_plan_record(stack_status::content, id, push_plan_path());
+                visit_path.pop_back();
             }
+            build_plan(id);
+            menu_plan[begin].skip = static_cast<uint32_t>(menu_plan.size());
+            push_plan_record(stack_status::end, id, path_offset);
+            visit_path.pop_back();
         }
-        if (path != "")
-            paths.push_back(path);
-        register_group(root_factory, paths, factory);
     }
-    void register_group_from_factorys(std::vector<std::pair<std::string, functor>> factorys)
-    {
-        for (auto& [path, factory] : factorys)
-            register_group_from_absolute_path(root_factory, path, factory);
-    }
-
-    enum class stack_status
-    {
-        begin,
-        content,
-        end
-    };
 
-    void for_each_group(std::shared_ptr<factory_groups> root_groups, std::function<bool(std::vector<std::string>, stack_status, bool, std::shared_ptr<factory_group<functor>>)> pred,
-                        std::vector<std::string> stack = {}, bool last_menu_status = true)
+    template <class Pred> void visit_group(index_t parent, Pred& pred, bool last_menu_status)
     {
-        if (!root_groups)
-            return;
-        for (auto& [path, groups] : *root_groups)
+        for (auto id = trie.node(parent).first_child; id != storage::npos; id = trie.node(id).next_sibling)
         {
-            if (groups->sub_groups->size() == 0)
+            group current(trie, id);
+            visit_path.push_back(trie.name(id));
+            if (!current.is_sub_group())
             {
-                stack.push_back(path);
-                pred(stack, stack_status::content, last_menu_status, groups);
-                stack.pop_back();
+                pred(std::span<const std::string_view>(visit_path), stack_status::content, last_menu_status, current);
+                visit_path.pop_back();
                 continue;
             }
-            stack.push_back(path);
-            auto menu_status = pred(stack, stack_status::begin, last_menu_status, groups);
-            for_each_group(groups->sub_groups, pred, stack, menu_status);
-            pred(stack, stack_status::end, menu_status, groups);
-            stack.pop_back();
+            bool menu_status = pred(std::span<const std::string_view>(visit_path), stack_status::begin, last_menu_status, current);
+            if (current.is_has_factory())
+            {
+                visit_path.push_back(trie.name(id));
+                pred(std::span<const std::string_view>(visit_path), stack_status::content, menu_status, current);
+                visit_path.pop_back();
+            }
+            visit_group(id, pred, menu_status);
+            pred(std::span<const std::string_view>(visit_path), stack_status::end, menu_status, current);
+            visit_path.pop_back();
         }
     }
-    void for_each(std::function<bool(std::vector<std::string>, stack_status, bool, std::shared_ptr<factory_group<functor>>)> pred, std::vector<std::string> stack = {},
-                        bool last_menu_status = true)
-    {
-        for_each_group(root_factory, pred, stack, last_menu_status);
-    }
 };
 
 struct node;
-using node_factorys = factory_group_manager<std::function<std::shared_ptr<node>()>>;
\ No newline at end of file
+using node_factorys = factory_group_manager<std::function<std::shared_ptr<node>()>>;
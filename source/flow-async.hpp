@@ -0,0 +1,476 @@
+#pragma once
+#if defined(__linux__)
+    #include <sys/epoll.h>
+    #include <sys/eventfd.h>
+    #include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// 协程恢复的去处：执行器把恢复提交为 tbb 任务，同步执行时交给等待中的线程
+class flow_scheduler
+{
+public:
+    virtual void schedule(std::coroutine_handle<> handle) = 0;
+
+protected:
+    ~flow_scheduler() = default;
+};
+
+// 节点协程的返回类型：创建后不立即运行，start 时在当前线程执行到第一次挂起，之后每次恢复都经 start 传入的调度器。
+// 可以 co_await 另一个 flow_task，内层协程沿用外层的调度器。完成（含抛出异常）时调用 start 传入的回调，
+// 回调返回前协程已停在终点，回调之后任意线程都可以销毁它
+class flow_task
+{
+public:
+    struct promise_type
+    {
+        flow_scheduler* scheduler = nullptr;
+        std::coroutine_handle<> continuation;
+        std::exception_ptr error;
+        void (*complete)(void*) = nullptr;
+        void* complete_context = nullptr;
+
+        flow_task get_return_object() { return flow_task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        auto final_suspend() noexcept
+        {
+            struct awaiter
+            {
+                bool await_ready() noexcept { return false; }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+                {
+                    auto& promise = handle.promise();
+                    if (promise.continuation)
+                        return promise.continuation;
+                    // 回调可能导致协程被销毁，先取出再调用
+                    auto complete = promise.complete;
+                    auto context = promise.complete_context;
+                    if (complete)
+                        complete(context);
+                    return std::noop_coroutine();
+                }
+                void await_resume() noexcept {}
+            };
+            return awaiter{};
+        }
+        void return_void() {}
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+    using handle_t = std::coroutine_handle<promise_type>;
+
+private:
+    handle_t handle;
+
+public:
+    flow_task() = default;
+    explicit flow_task(handle_t handle) : handle(handle) {}
+    flow_task(flow_task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    flow_task& operator=(flow_task&& other) noexcept
+    {
+        if (this != &other)
+        {
+            if (handle)
+                handle.destroy();
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+    ~flow_task()
+    {
+        if (handle)
+            handle.destroy();
+    }
+
+public:
+    bool valid() const { return static_cast<bool>(handle); }
+    bool done() const { return handle && handle.done(); }
+    void start(flow_scheduler& scheduler, void (*complete)(void*), void* context)
+    {
+        auto& promise = handle.promise();
+        promise.scheduler = &scheduler;
+        promise.complete = complete;
+        promise.complete_context = context;
+        handle.resume();
+    }
+    // 完成后调用，重新抛出协程中未捕获的异常
+    void result() const
+    {
+        if (handle.promise().error)
+            std::rethrow_exception(handle.promise().error);
+    }
+
+    auto operator co_await() && noexcept
+    {
+        struct awaiter
+        {
+            handle_t child;
+            bool await_ready() noexcept { return !child || child.done(); }
+            std::coroutine_handle<> await_suspend(handle_t parent) noexcept
+            {
+                child.promise().scheduler = parent.promise().scheduler;
+                child.promise().continuation = parent;
+                return child;
+            }
+            void await_resume()
+            {
+                if (child && child.promise().error)
+                    std::rethrow_exception(child.promise().error);
+            }
+        };
+        return awaiter{ handle };
+    }
+};
+
+// 在当前线程驱动协程直到完成，期间的恢复都在当前线程进行；节点不经 flow_executor 直接执行时使用
+inline void flow_run_blocking(flow_task task)
+{
+    struct blocking_scheduler : flow_scheduler
+    {
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<std::coroutine_handle<>> queue;
+        bool done = false;
+
+        // 在锁内通知：等待方醒来后调度器即可能析构
+        void schedule(std::coroutine_handle<> handle) override
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(handle);
+            ready.notify_one();
+        }
+        static void complete(void* context)
+        {
+            auto scheduler = static_cast<blocking_scheduler*>(context);
+            std::lock_guard<std::mutex> lock(scheduler->mutex);
+            scheduler->done = true;
+            scheduler->ready.notify_one();
+        }
+    } scheduler;
+
+    task.start(scheduler, &blocking_scheduler::complete, &scheduler);
+    std::unique_lock<std::mutex> lock(scheduler.mutex);
+    while (true)
+    {
+        scheduler.ready.wait(lock, [&] { return scheduler.done || !scheduler.queue.empty(); });
+        if (scheduler.queue.empty())
+            break;
+        auto handle = scheduler.queue.front();
+        scheduler.queue.pop_front();
+        lock.unlock();
+        handle.resume();
+        lock.lock();
+    }
+    lock.unlock();
+    task.result();
+}
+
+// 由任意线程 set 的事件，用于解码线程、进程间通信回调等不经文件描述符的完成通知；
+// 等待它的协程经各自的调度器恢复，set 之后再等待立即继续，直到 reset
+class flow_event
+{
+    std::mutex mutex;
+    bool signaled = false;
+    std::vector<std::pair<std::coroutine_handle<>, flow_scheduler*>> waiters;
+
+public:
+    void set()
+    {
+        decltype(waiters) ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            signaled = true;
+            ready.swap(waiters);
+        }
+        for (auto [handle, scheduler] : ready)
+            scheduler->schedule(handle);
+    }
+    void reset()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        signaled = false;
+    }
+    bool is_set()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return signaled;
+    }
+
+    auto operator co_await() noexcept
+    {
+        struct awaiter
+        {
+            flow_event& event;
+            bool await_ready() noexcept { return false; }
+            bool await_suspend(flow_task::handle_t handle)
+            {
+                std::lock_guard<std::mutex> lock(event.mutex);
+                if (event.signaled)
+                    return false;
+                event.waiters.emplace_back(handle, handle.promise().scheduler);
+                return true;
+            }
+            void await_resume() noexcept {}
+        };
+        return awaiter{ *this };
+    }
+};
+
+// 事件循环：一个后台线程等待文件描述符就绪（Linux 上为 epoll）与定时器到期，就绪后把协程交给它所属的调度器恢复，
+// 等待期间不占用工作线程。同一文件描述符的同一方向同时只能有一个等待者；其它平台只提供定时器
+class flow_reactor
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+private:
+    struct waiter_t
+    {
+        std::coroutine_handle<> handle;
+        flow_scheduler* scheduler = nullptr;
+    };
+    struct timer_t
+    {
+        clock::time_point deadline;
+        uint64_t sequence = 0;
+        waiter_t waiter;
+        bool operator>(const timer_t& other) const { return deadline != other.deadline ? deadline > other.deadline : sequence > other.sequence; }
+    };
+
+    std::mutex mutex;
+    std::priority_queue<timer_t, std::vector<timer_t>, std::greater<>> timers;
+    uint64_t timer_sequence = 0;
+    bool stopping = false;
+#if defined(__linux__)
+    struct interest_t
+    {
+        waiter_t read;
+        waiter_t write;
+    };
+    std::unordered_map<int, interest_t> interests;
+    int epoll_fd = -1;
+    int wake_fd = -1;
+#else
+    std::condition_variable woken;
+#endif
+    std::thread thread;
+
+public:
+    flow_reactor()
+    {
+#if defined(__linux__)
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (epoll_fd < 0 || wake_fd < 0)
+            throw std::system_error(errno, std::system_category(), "flow_reactor: 创建 epoll 失败");
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = wake_fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
+#endif
+        thread = std::thread([this] { loop(); });
+    }
+    flow_reactor(const flow_reactor&) = delete;
+    flow_reactor& operator=(const flow_reactor&) = delete;
+    // 尚在等待的协程不再恢复
+    ~flow_reactor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake();
+        thread.join();
+#if defined(__linux__)
+        close(wake_fd);
+        close(epoll_fd);
+#endif
+    }
+
+    static flow_reactor& instance()
+    {
+        static flow_reactor reactor;
+        return reactor;
+    }
+
+public:
+    auto sleep_until(clock::time_point deadline)
+    {
+        struct awaiter
+        {
+            flow_reactor& reactor;
+            clock::time_point deadline;
+            bool await_ready() const { return deadline <= clock::now(); }
+            void await_suspend(flow_task::handle_t handle) { reactor.add_timer(deadline, { handle, handle.promise().scheduler }); }
+            void await_resume() noexcept {}
+        };
+        return awaiter{ *this, deadline };
+    }
+    auto sleep_for(clock::duration duration) { return sleep_until(clock::now() + duration); }
+
+#if defined(__linux__)
+    // 等待 fd 可读或可写；出错或对端关闭时同样恢复，由随后的读写报告错误
+    auto readable(int fd) { return io_awaiter{ *this, fd, false }; }
+    auto writable(int fd) { return io_awaiter{ *this, fd, true }; }
+
+private:
+    struct io_awaiter
+    {
+        flow_reactor& reactor;
+        int fd;
+        bool write;
+        bool await_ready() noexcept { return false; }
+        void await_suspend(flow_task::handle_t handle) { reactor.watch(fd, write, { handle, handle.promise().scheduler }); }
+        void await_resume() noexcept {}
+    };
+
+    void watch(int fd, bool write, waiter_t waiter)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& interest = interests[fd];
+        auto& slot = write ? interest.write : interest.read;
+        if (slot.handle)
+            throw std::logic_error("flow_reactor: 同一文件描述符的同一方向已有等待者");
+        bool registered = interest.read.handle || interest.write.handle;
+        slot = waiter;
+        if (!arm(fd, interest, registered))
+        {
+            auto error = errno;
+            slot = {};
+            if (!interest.read.handle && !interest.write.handle)
+                interests.erase(fd);
+            throw std::system_error(error, std::system_category(), "flow_reactor: epoll_ctl 失败");
+        }
+    }
+    // 按剩余的等待方向重新登记；fd 登记过且一次性事件已触发时 ADD 会报 EEXIST，改用 MOD
+    bool arm(int fd, const interest_t& interest, bool registered)
+    {
+        epoll_event event{};
+        event.events = EPOLLONESHOT | (interest.read.handle ? EPOLLIN | EPOLLRDHUP : 0u) | (interest.write.handle ? EPOLLOUT : 0u);
+        event.data.fd = fd;
+        if (registered)
+            return epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event) == 0;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0)
+            return true;
+        return errno == EEXIST && epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event) == 0;
+    }
+#endif
+
+private:
+    void add_timer(clock::time_point deadline, waiter_t waiter)
+    {
+        bool earliest = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            earliest = timers.empty() || deadline < timers.top().deadline;
+            timers.push({ deadline, timer_sequence++, waiter });
+        }
+        if (earliest)
+            wake();
+    }
+    void wake()
+    {
+#if defined(__linux__)
+        uint64_t one = 1;
+        std::ignore = write(wake_fd, &one, sizeof(one));
+#else
+        woken.notify_one();
+#endif
+    }
+    // 取出已到期的定时器，返回距下一个定时器到期的时间
+    std::optional<clock::duration> expire(std::vector<waiter_t>& ready)
+    {
+        auto now = clock::now();
+        while (!timers.empty() && timers.top().deadline <= now)
+        {
+            ready.push_back(timers.top().waiter);
+            timers.pop();
+        }
+        if (timers.empty())
+            return std::nullopt;
+        return timers.top().deadline - now;
+    }
+
+    void loop()
+    {
+        std::vector<waiter_t> ready;
+        while (true)
+        {
+            std::optional<clock::duration> timeout;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (stopping)
+                    return;
+                timeout = expire(ready);
+#if !defined(__linux__)
+                if (ready.empty())
+                {
+                    if (timeout)
+                        woken.wait_for(lock, *timeout);
+                    else
+                        woken.wait(lock);
+                    continue;
+                }
+#endif
+            }
+#if defined(__linux__)
+            if (ready.empty())
+            {
+                int milliseconds = timeout ? static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(*timeout).count()) : -1;
+                epoll_event events[64];
+                int count = epoll_wait(epoll_fd, events, 64, milliseconds);
+                std::lock_guard<std::mutex> lock(mutex);
+                for (int i = 0; i < count; i++)
+                    collect(events[i], ready);
+                expire(ready);
+            }
+#endif
+            for (auto& waiter : ready)
+                waiter.scheduler->schedule(waiter.handle);
+            ready.clear();
+        }
+    }
+
+#if defined(__linux__)
+    void collect(const epoll_event& event, std::vector<waiter_t>& ready)
+    {
+        int fd = event.data.fd;
+        if (fd == wake_fd)
+        {
+            uint64_t value = 0;
+            std::ignore = read(wake_fd, &value, sizeof(value));
+            return;
+        }
+        auto it = interests.find(fd);
+        if (it == interests.end())
+            return;
+        auto& interest = it->second;
+        bool failed = event.events & (EPOLLERR | EPOLLHUP);
+        if (interest.read.handle && (failed || (event.events & (EPOLLIN | EPOLLRDHUP))))
+            ready.push_back(std::exchange(interest.read, {}));
+        if (interest.write.handle && (failed || (event.events & EPOLLOUT)))
+            ready.push_back(std::exchange(interest.write, {}));
+        if (!interest.read.handle && !interest.write.handle)
+            interests.erase(it);
+        else
+            arm(fd, interest, true);
+    }
+#endif
+};
@@ -0,0 +1,125 @@
+#pragma once
+#include "flow-pixel.hpp"
+#include "flow.hpp"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// 编译后的执行计划：按拓扑序排成一列步骤，相邻的逐像素节点（前一个的输出只连到后一个）融合为一步，
+// 整条链对每段像素只读写一次内存，中间节点的输出不再生成。计划在节点图拓扑变化前一直复用；
+// 步骤按顺序执行，融合步骤与逐像素节点内部按行带并行
+class flow_program
+{
+public:
+    using index_t = flow_graph::index_t;
+
+    // chain_size 为 0 表示普通节点，否则 node 为链首，链上的节点依次存放在 chain_nodes 的 [chain_begin, chain_begin + chain_size)
+    struct step_t
+    {
+        index_t node = flow_graph::npos;
+        uint32_t chain_begin = 0;
+        uint32_t chain_size = 0;
+    };
+
+private:
+    uint64_t compiled_version = 0;
+    std::vector<step_t> steps;
+    std::vector<index_t> chain_nodes;
+    std::vector<pixel_op> ops;
+    flow_scratch_arena scratch;
+
+public:
+    bool compiled(const flow_graph& graph) const { return compiled_version == graph.topology_version(); }
+    std::span<const step_t> plan() const { return steps; }
+    std::span<const index_t> chain(const step_t& step) const { return std::span<const index_t>(chain_nodes).subspan(step.chain_begin, step.chain_size); }
+    size_t fused_node_count() const { return chain_nodes.size(); }
+
+    void compile(flow_graph& graph)
+    {
+        auto order = graph.plan();
+        steps.clear();
+        chain_nodes.clear();
+        std::vector<uint8_t> placed(graph.capacity(), 0);
+        for (auto id : order)
+        {
+            if (placed[id])
+                continue;
+            placed[id] = 1;
+            if (!elementwise(graph, id) || fusable(graph, id))
+            {
+                steps.push_back({ id });
+                continue;
+            }
+
+            step_t step{ id, static_cast<uint32_t>(chain_nodes.size()), 0 };
+            chain_nodes.push_back(id);
+            for (auto tail = id; graph.slot(tail).successors.size() == 1;)
+            {
+                auto next = graph.slot(tail).successors.front();
+                if (!elementwise(graph, next) || !fusable(graph, next))
+                    break;
+                chain_nodes.push_back(next);
+                placed[next] = 1;
+                tail = next;
+            }
+            step.chain_size = static_cast<uint32_t>(chain_nodes.size() - step.chain_begin);
+            if (step.chain_size == 1)
+            {
+                chain_nodes.pop_back();
+                step.chain_size = 0;
+            }
+            steps.push_back(step);
+        }
+        compiled_version = graph.topology_version();
+    }
+
+    // 拓扑变化后自动重新编译；节点抛出的异常直接传给调用方。临时内存在最后一步结束后（包括因异常退出时）整体回收
+    void run(flow_graph& graph)
+    {
+        if (!compiled(graph))
+            compile(graph);
+        struct scratch_guard
+        {
+            flow_scratch_arena* arena;
+            ~scratch_guard() { arena->reset(); }
+        } guard{ &scratch };
+        for (auto& step : steps)
+        {
+            if (step.chain_size == 0)
+            {
+                graph.execute(step.node, nullptr, &scratch);
+                continue;
+            }
+            run_chain(graph, chain(step));
+        }
+    }
+
+private:
+    static elementwise_node* elementwise(const flow_graph& graph, index_t id) { return dynamic_cast<elementwise_node*>(graph.at(id).get()); }
+    // id 的输入来自一个只连到 id 的逐像素节点时，id 可以接在该节点之后融合
+    static bool fusable(const flow_graph& graph, index_t id)
+    {
+        auto source = graph.slot(id).sources.front().node;
+        return source != flow_graph::npos && elementwise(graph, source) && graph.slot(source).successors.size() == 1;
+    }
+    void run_chain(flow_graph& graph, std::span<const index_t> nodes)
+    {
+        auto head = nodes.front();
+        auto tail = nodes.back();
+        auto input = graph.input_value(head, elementwise(graph, head)->src.index);
+        auto src = input ? std::any_cast<cv::Mat>(input) : nullptr;
+        if (!src)
+            throw std::logic_error("flow_program: 融合链的输入端口未连接或上游没有产出");
+
+        ops.clear();
+        for (auto id : nodes)
+            ops.push_back(elementwise(graph, id)->op());
+        auto out_node = elementwise(graph, tail);
+        flow_context ctx({}, graph.output_values(tail));
+        run_pixel_ops(ctx, out_node->dst, *src, ops);
+        for (auto id : nodes.first(nodes.size() - 1))
+            graph.mark_elided(id);
+        graph.mark_evaluated(tail);
+    }
+};
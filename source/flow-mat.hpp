@@ -0,0 +1,192 @@
+#pragma once
+#include <opencv2/core.hpp>
+
+#include "flow.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+// cv::Mat 的缓冲池：作为 cv::MatAllocator 接管 Mat::create 的内存，最后一个引用释放时缓冲回到空闲表而不是交还系统；
+// 空闲表按字节数分组，行列与类型不同但大小相同的图像也能复用同一块内存。缓冲均按 64 字节对齐，
+// 空闲缓冲总量超过上限时直接释放。池对象有意不析构，静态析构之后才释放的 Mat 仍能安全归还
+class mat_buffer_pool : public cv::MatAllocator
+{
+public:
+    static constexpr size_t alignment = 64;
+
+    struct stats_t
+    {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t buffers_in_use = 0;
+        size_t buffers_free = 0;
+        size_t bytes_in_use = 0;
+        size_t bytes_free = 0;
+        size_t peak_bytes_in_use = 0;
+        size_t peak_bytes_total = 0;
+        size_t max_free_bytes = 0;
+    };
+
+private:
+    mutable std::mutex mutex;
+    mutable std::unordered_map<size_t, std::vector<void*>> free_buffers;
+    mutable stats_t counters;
+
+public:
+    explicit mat_buffer_pool(size_t max_free_bytes = 1ull << 30) { counters.max_free_bytes = max_free_bytes; }
+    mat_buffer_pool(const mat_buffer_pool&) = delete;
+    mat_buffer_pool& operator=(const mat_buffer_pool&) = delete;
+    ~mat_buffer_pool() override { trim(); }
+
+    static mat_buffer_pool& instance()
+    {
+        static mat_buffer_pool* pool = new mat_buffer_pool();
+        return *pool;
+    }
+
+public:
+    // 从池中取得 rows x cols 的图像；返回的 Mat 之后 create 成其它尺寸时仍由本池分配
+    cv::Mat acquire(int rows, int cols, int type)
+    {
+        cv::Mat mat;
+        mat.allocator = this;
+        mat.create(rows, cols, type);
+        return mat;
+    }
+    stats_t stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return counters;
+    }
+    void set_max_free_bytes(size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.max_free_bytes = bytes;
+        shrink(bytes);
+    }
+    // 释放全部空闲缓冲
+    void trim()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shrink(0);
+    }
+
+public:
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step, cv::AccessFlag, cv::UMatUsageFlags) const override
+    {
+        size_t total = CV_ELEM_SIZE(type);
+        for (int i = dims - 1; i >= 0; i--)
+        {
+            if (step)
+            {
+                if (data && step[i] != CV_AUTOSTEP)
+                {
+                    CV_Assert(total <= step[i]);
+                    total = step[i];
+                }
+                else
+                    step[i] = total;
+            }
+            total *= sizes[i];
+        }
+
+        auto u = new cv::UMatData(this);
+        u->size = total;
+        if (data)
+        {
+            u->data = u->origdata = static_cast<uchar*>(data);
+            u->flags |= cv::UMatData::USER_ALLOCATED;
+            return u;
+        }
+        u->data = u->origdata = static_cast<uchar*>(take(total));
+        return u;
+    }
+    bool allocate(cv::UMatData* u, cv::AccessFlag, cv::UMatUsageFlags) const override { return u != nullptr; }
+    void deallocate(cv::UMatData* u) const override
+    {
+        if (!u)
+            return;
+        CV_Assert(u->urefcount == 0);
+        CV_Assert(u->refcount == 0);
+        if (!(u->flags & cv::UMatData::USER_ALLOCATED))
+        {
+            give_back(u->origdata, u->size);
+            u->origdata = nullptr;
+        }
+        delete u;
+    }
+
+private:
+    void* take(size_t bytes) const
+    {
+        flow_count_allocation(bytes);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (auto it = free_buffers.find(bytes); it != free_buffers.end() && !it->second.empty())
+            {
+                auto buffer = it->second.back();
+                it->second.pop_back();
+                counters.hits++;
+                counters.buffers_free--;
+                counters.bytes_free -= bytes;
+                mark_in_use(bytes);
+                return buffer;
+            }
+            counters.misses++;
+            mark_in_use(bytes);
+        }
+        return ::operator new(bytes, std::align_val_t(alignment));
+    }
+    void give_back(void* buffer, size_t bytes) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.buffers_in_use--;
+        counters.bytes_in_use -= bytes;
+        if (counters.bytes_free + bytes > counters.max_free_bytes)
+        {
+            ::operator delete(buffer, std::align_val_t(alignment));
+            return;
+        }
+        free_buffers[bytes].push_back(buffer);
+        counters.buffers_free++;
+        counters.bytes_free += bytes;
+    }
+    void mark_in_use(size_t bytes) const
+    {
+        counters.buffers_in_use++;
+        counters.bytes_in_use += bytes;
+        counters.peak_bytes_in_use = std::max(counters.peak_bytes_in_use, counters.bytes_in_use);
+        counters.peak_bytes_total = std::max(counters.peak_bytes_total, counters.bytes_in_use + counters.bytes_free);
+    }
+    void shrink(size_t max_free_bytes) const
+    {
+        for (auto it = free_buffers.begin(); it != free_buffers.end() && counters.bytes_free > max_free_bytes;)
+        {
+            auto& buffers = it->second;
+            while (!buffers.empty() && counters.bytes_free > max_free_bytes)
+            {
+                ::operator delete(buffers.back(), std::align_val_t(alignment));
+                buffers.pop_back();
+                counters.buffers_free--;
+                counters.bytes_free -= it->first;
+            }
+            it = buffers.empty() ? free_buffers.erase(it) : std::next(it);
+        }
+    }
+};
+
+// 节点写出图像的推荐方式：上次的输出若已无其它引用（下游与结果缓存都不再持有）且尺寸类型相同则原地复用，
+// 否则从缓冲池取一块新的；图像在节点之间只按引用计数传递，不发生拷贝
+inline cv::Mat& output_mat(flow_context& ctx, output_port<cv::Mat> port, int rows, int cols, int type, mat_buffer_pool& pool = mat_buffer_pool::instance())
+{
+    auto& mat = ctx.output_value(port);
+    bool reusable = mat.u != nullptr && mat.u->refcount == 1 && mat.allocator == &pool && mat.rows == rows && mat.cols == cols && mat.type() == type && mat.isContinuous();
+    if (!reusable)
+        mat = pool.acquire(rows, cols, type);
+    return mat;
+}
@@ -0,0 +1,134 @@
+#pragma once
+#if __has_include(<opencv2/core.hpp>)
+    #include <opencv2/core.hpp>
+#endif
+
+#include <any>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// 端口值占用的字节数，用于结果缓存的内存预算；默认按 sizeof 计，持有外部内存的类型需特化
+template <class T> struct flow_value_size
+{
+    static size_t bytes(const T&) { return sizeof(T); }
+};
+template <class T> struct flow_value_size<std::vector<T>>
+{
+    static size_t bytes(const std::vector<T>& value) { return sizeof(value) + value.capacity() * sizeof(T); }
+};
+#if __has_include(<opencv2/core.hpp>)
+template <> struct flow_value_size<cv::Mat>
+{
+    static size_t bytes(const cv::Mat& value) { return sizeof(value) + value.total() * value.elemSize(); }
+};
+#endif
+
+inline uint64_t flow_hash_mix(uint64_t hash, uint64_t value)
+{
+    hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+    hash ^= hash >> 31;
+    hash *= 0xbf58476d1ce4e5b9ull;
+    hash ^= hash >> 29;
+    return hash;
+}
+
+// 节点输出的结果缓存：键由节点类型、参数哈希与各输入的内容键组合而成，相同参数的重复子图与多次执行共用一份结果；
+// 按最近使用淘汰，总字节数不超过预算，超过预算的单个结果不缓存。多个工作线程可同时查询与写入
+class flow_memo_cache
+{
+public:
+    struct stats_t
+    {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+        size_t budget = 0;
+    };
+
+private:
+    struct entry_t
+    {
+        uint64_t key = 0;
+        size_t bytes = 0;
+        std::vector<std::any> values;
+    };
+
+    mutable std::mutex mutex;
+    std::list<entry_t> entries;
+    std::unordered_map<uint64_t, std::list<entry_t>::iterator> index;
+    stats_t counters;
+
+public:
+    explicit flow_memo_cache(size_t budget_bytes = 256ull << 20) { counters.budget = budget_bytes; }
+
+public:
+    // 命中时把缓存的输出拷贝到 values（cv::Mat 等只增加引用计数）并把该项移到最近使用的位置
+    bool lookup(uint64_t key, std::vector<std::any>& values)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it == index.end())
+        {
+            counters.misses++;
+            return false;
+        }
+        entries.splice(entries.begin(), entries, it->second);
+        values = it->second->values;
+        counters.hits++;
+        return true;
+    }
+    void insert(uint64_t key, const std::vector<std::any>& values, size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (bytes > counters.budget)
+            return;
+        if (auto it = index.find(key); it != index.end())
+        {
+            counters.bytes -= it->second->bytes;
+            entries.erase(it->second);
+            index.erase(it);
+        }
+        entries.push_front({ key, bytes, values });
+        index.emplace(key, entries.begin());
+        counters.bytes += bytes;
+        evict(counters.budget);
+    }
+    void set_budget(size_t budget_bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.budget = budget_bytes;
+        evict(budget_bytes);
+    }
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+        index.clear();
+        counters.bytes = 0;
+    }
+    stats_t stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto result = counters;
+        result.entries = index.size();
+        return result;
+    }
+
+private:
+    void evict(size_t budget_bytes)
+    {
+        while (counters.bytes > budget_bytes && !entries.empty())
+        {
+            counters.bytes -= entries.back().bytes;
+            index.erase(entries.back().key);
+            entries.pop_back();
+            counters.evictions++;
+        }
+    }
+};
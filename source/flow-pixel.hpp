@@ -0,0 +1,388 @@
+#pragma once
+#include <opencv2/core.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include "flow-mat.hpp"
+#include "flow-tile.hpp"
+#include "flow.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+// 逐像素运算：affine 为 x * a + b，clamp 把值限制在 [a, b]，mix 为通道混合（out = matrix * in + offset），
+// 可改变通道数，用于颜色空间转换。运算对每个通道的浮点值进行，8 位图像在每个运算之后饱和取整，
+// 融合执行与逐个节点执行的结果逐位相同
+struct pixel_op
+{
+    enum class kind : uint8_t
+    {
+        affine,
+        clamp,
+        mix,
+    };
+    kind type = kind::affine;
+    float a = 1.0f;
+    float b = 0.0f;
+    int in_channels = 0;
+    int out_channels = 0;
+    std::array<float, 16> matrix = {};
+    std::array<float, 4> offset = {};
+
+    static pixel_op affine(float scale, float shift) { return { kind::affine, scale, shift }; }
+    static pixel_op clamp(float low, float high) { return { kind::clamp, low, high }; }
+    // matrix 按行存放 out_channels 行、in_channels 列
+    static pixel_op mix(int in_channels, int out_channels, std::initializer_list<float> matrix, std::initializer_list<float> offset = {})
+    {
+        if (in_channels < 1 || in_channels > 4 || out_channels < 1 || out_channels > 4 || matrix.size() != static_cast<size_t>(in_channels * out_channels) || offset.size() > 4)
+            throw std::invalid_argument("pixel_op::mix: 通道数需在 1 到 4 之间且矩阵大小为 out_channels * in_channels");
+        pixel_op op{ kind::mix };
+        op.in_channels = in_channels;
+        op.out_channels = out_channels;
+        std::copy(matrix.begin(), matrix.end(), op.matrix.begin());
+        std::copy(offset.begin(), offset.end(), op.offset.begin());
+        return op;
+    }
+    static pixel_op bgr_to_gray() { return mix(3, 1, { 0.114f, 0.587f, 0.299f }); }
+    static pixel_op bgr_to_rgb() { return mix(3, 3, { 0, 0, 1, 0, 1, 0, 1, 0, 0 }); }
+    // BT.601，输出通道顺序为 Y, Cr, Cb，与 cv::COLOR_BGR2YCrCb 一致
+    static pixel_op bgr_to_ycrcb() { return mix(3, 3, { 0.114f, 0.587f, 0.299f, -0.0813f, -0.4187f, 0.5f, 0.5f, -0.3313f, -0.1687f }, { 0.0f, 128.0f, 128.0f }); }
+
+    uint64_t hash() const
+    {
+        auto bits = [](float value) { return static_cast<uint64_t>(std::bit_cast<uint32_t>(value)); };
+        uint64_t hash = flow_hash_mix(static_cast<uint64_t>(type), bits(a));
+        hash = flow_hash_mix(hash, bits(b));
+        hash = flow_hash_mix(hash, static_cast<uint64_t>(in_channels) << 8 | static_cast<uint64_t>(out_channels));
+        for (auto value : matrix)
+            hash = flow_hash_mix(hash, bits(value));
+        for (auto value : offset)
+            hash = flow_hash_mix(hash, bits(value));
+        return hash;
+    }
+};
+
+// 融合执行逐像素运算链：每次把一段像素读入 L1 中的浮点缓冲，依次应用全部运算后再写回，中间结果不落到内存。
+// 各运算用 OpenCV 的通用 intrinsics 按向量宽度处理（SSE/AVX/NEON 由 OpenCV 的编译配置决定），余下的尾部逐个处理
+namespace pixel_kernel
+{
+    constexpr int chunk_pixels = 256;
+
+    inline int output_channels(int channels, std::span<const pixel_op> ops)
+    {
+        for (auto& op : ops)
+        {
+            if (op.type != pixel_op::kind::mix)
+                continue;
+            if (op.in_channels != channels)
+                throw std::invalid_argument("pixel_kernel: 通道混合的输入通道数与图像不符");
+            channels = op.out_channels;
+        }
+        return channels;
+    }
+
+    inline void load(const uchar* src, float* dst, int count)
+    {
+        int i = 0;
+#if CV_SIMD
+        const int lanes = cv::VTraits<cv::v_float32>::vlanes();
+        for (; i + lanes <= count; i += lanes)
+            cv::v_store(dst + i, cv::v_cvt_f32(cv::v_reinterpret_as_s32(cv::vx_load_expand_q(src + i))));
+#endif
+        for (; i < count; i++)
+            dst[i] = static_cast<float>(src[i]);
+    }
+    inline void load(const float* src, float* dst, int count) { std::copy(src, src + count, dst); }
+    inline void store(const float* src, uchar* dst, int count)
+    {
+        int i = 0;
+#if CV_SIMD
+        const int lanes = cv::VTraits<cv::v_float32>::vlanes();
+        for (; i + lanes * 4 <= count; i += lanes * 4)
+        {
+            auto low = cv::v_pack(cv::v_round(cv::vx_load(src + i)), cv::v_round(cv::vx_load(src + i + lanes)));
+            auto high = cv::v_pack(cv::v_round(cv::vx_load(src + i + lanes * 2)), cv::v_round(cv::vx_load(src + i + lanes * 3)));
+            cv::v_store(dst + i, cv::v_pack_u(low, high));
+        }
+#endif
+        for (; i < count; i++)
+            dst[i] = cv::saturate_cast<uchar>(src[i]);
+    }
+    inline void store(const float* src, float* dst, int count) { std::copy(src, src + count, dst); }
+    // 按 8 位写回的方式就地取整并饱和到 [0, 255]，与 store 的舍入规则一致
+    inline void saturate_u8(float* buffer, int count)
+    {
+        int i = 0;
+#if CV_SIMD
+        const int lanes = cv::VTraits<cv::v_float32>::vlanes();
+        auto vlow = cv::vx_setzero_s32();
+        auto vhigh = cv::vx_setall_s32(255);
+        for (; i + lanes <= count; i += lanes)
+            cv::v_store(buffer + i, cv::v_cvt_f32(cv::v_min(cv::v_max(cv::v_round(cv::vx_load(buffer + i)), vlow), vhigh)));
+#endif
+        for (; i < count; i++)
+            buffer[i] = static_cast<float>(cv::saturate_cast<uchar>(buffer[i]));
+    }
+
+    inline void affine(float* buffer, int count, float a, float b)
+    {
+        int i = 0;
+#if CV_SIMD
+        const int lanes = cv::VTraits<cv::v_float32>::vlanes();
+        auto va = cv::vx_setall_f32(a);
+        auto vb = cv::vx_setall_f32(b);
+        for (; i + lanes <= count; i += lanes)
+            cv::v_store(buffer + i, cv::v_fma(cv::vx_load(buffer + i), va, vb));
+#endif
+        for (; i < count; i++)
+            buffer[i] = buffer[i] * a + b;
+    }
+    inline void clamp(float* buffer, int count, float low, float high)
+    {
+        int i = 0;
+#if CV_SIMD
+        const int lanes = cv::VTraits<cv::v_float32>::vlanes();
+        auto vlow = cv::vx_setall_f32(low);
+        auto vhigh = cv::vx_setall_f32(high);
+        for (; i + lanes <= count; i += lanes)
+            cv::v_store(buffer + i, cv::v_min(cv::v_max(cv::vx_load(buffer + i), vlow), vhigh));
+#endif
+        for (; i < count; i++)
+            buffer[i] = std::min(std::max(buffer[i], low), high);
+    }
+
+#if CV_SIMD
+    template <int channels> inline void load_channels(const float* src, cv::v_float32* values)
+    {
+        if constexpr (channels == 1)
+            values[0] = cv::vx_load(src);
+        else if constexpr (channels == 2)
+            cv::v_load_deinterleave(src, values[0], values[1]);
+        else if constexpr (channels == 3)
+            cv::v_load_deinterleave(src, values[0], values[1], values[2]);
+        else
+            cv::v_load_deinterleave(src, values[0], values[1], values[2], values[3]);
+    }
+    template <int channels> inline void store_channels(float* dst, const cv::v_float32* values)
+    {
+        if constexpr (channels == 1)
+            cv::v_store(dst, values[0]);
+        else if constexpr (channels == 2)
+            cv::v_store_interleave(dst, values[0], values[1]);
+        else if constexpr (channels == 3)
+            cv::v_store_interleave(dst, values[0], values[1], values[2]);
+        else
+            cv::v_store_interleave(dst, values[0], values[1], values[2], values[3]);
+    }
+#endif
+    template <int in, int out> inline void mix(const pixel_op& op, const float* src, float* dst, int pixels)
+    {
+        int p = 0;
+#if CV_SIMD
+        const int lanes = cv::VTraits<cv::v_float32>::vlanes();
+        cv::v_float32 coefficients[in * out];
+        cv::v_float32 offsets[out];
+        for (int c = 0; c < out; c++)
+        {
+            offsets[c] = cv::vx_setall_f32(op.offset[c]);
+            for (int k = 0; k < in; k++)
+                coefficients[c * in + k] = cv::vx_setall_f32(op.matrix[c * in + k]);
+        }
+        for (; p + lanes <= pixels; p += lanes)
+        {
+            cv::v_float32 x[in];
+            cv::v_float32 y[out];
+            load_channels<in>(src + p * in, x);
+            for (int c = 0; c < out; c++)
+            {
+                y[c] = offsets[c];
+                for (int k = 0; k < in; k++)
+                    y[c] = cv::v_fma(coefficients[c * in + k], x[k], y[c]);
+            }
+            store_channels<out>(dst + p * out, y);
+        }
+#endif
+        for (; p < pixels; p++)
+            for (int c = 0; c < out; c++)
+            {
+                float value = op.offset[c];
+                for (int k = 0; k < in; k++)
+                    value += op.matrix[c * in + k] * src[p * in + k];
+                dst[p * out + c] = value;
+            }
+    }
+    template <int in> inline void mix(const pixel_op& op, const float* src, float* dst, int pixels)
+    {
+        switch (op.out_channels)
+        {
+            case 1: mix<in, 1>(op, src, dst, pixels); break;
+            case 2: mix<in, 2>(op, src, dst, pixels); break;
+            case 3: mix<in, 3>(op, src, dst, pixels); break;
+            default: mix<in, 4>(op, src, dst, pixels); break;
+        }
+    }
+
+    // 对一段像素应用全部运算，返回结果所在的缓冲。saturate 为 true 时（8 位图像）每个中间结果都饱和取整，
+    // 最后一个运算的结果由 store 处理
+    inline float* apply(std::span<const pixel_op> ops, float* buffer, float* scratch, int pixels, int channels, bool saturate)
+    {
+        for (size_t index = 0; index < ops.size(); index++)
+        {
+            auto& op = ops[index];
+            switch (op.type)
+            {
+                case pixel_op::kind::affine: affine(buffer, pixels * channels, op.a, op.b); break;
+                case pixel_op::kind::clamp: clamp(buffer, pixels * channels, op.a, op.b); break;
+                case pixel_op::kind::mix:
+                    switch (op.in_channels)
+                    {
+                        case 1: mix<1>(op, buffer, scratch, pixels); break;
+                        case 2: mix<2>(op, buffer, scratch, pixels); break;
+                        case 3: mix<3>(op, buffer, scratch, pixels); break;
+                        default: mix<4>(op, buffer, scratch, pixels); break;
+                    }
+                    std::swap(buffer, scratch);
+                    channels = op.out_channels;
+                    break;
+            }
+            if (saturate && index + 1 < ops.size())
+                saturate_u8(buffer, pixels * channels);
+        }
+        return buffer;
+    }
+
+    template <class Src, class Dst> inline void run_row(const Src* src, Dst* dst, int width, int channels, std::span<const pixel_op> ops)
+    {
+        alignas(64) float buffer[chunk_pixels * 4];
+        alignas(64) float scratch[chunk_pixels * 4];
+        int out = output_channels(channels, ops);
+        for (int x = 0; x < width; x += chunk_pixels)
+        {
+            int pixels = std::min(chunk_pixels, width - x);
+            load(src + x * channels, buffer, pixels * channels);
+            auto result = apply(ops, buffer, scratch, pixels, channels, std::is_same_v<Src, uchar>);
+            store(result, dst + x * out, pixels * out);
+        }
+#if CV_SIMD
+        cv::vx_cleanup();
+#endif
+    }
+} // namespace pixel_kernel
+
+// 在当前线程处理 src 的 [begin, end) 行，dst 须已按输出类型分配好（可以是 ROI）
+inline void run_pixel_rows(const cv::Mat& src, cv::Mat& dst, std::span<const pixel_op> ops, int begin, int end)
+{
+    for (int y = begin; y < end; y++)
+    {
+        if (src.depth() == CV_8U)
+            pixel_kernel::run_row(src.ptr<uchar>(y), dst.ptr<uchar>(y), src.cols, src.channels(), ops);
+        else
+            pixel_kernel::run_row(src.ptr<float>(y), dst.ptr<float>(y), src.cols, src.channels(), ops);
+    }
+}
+// 对整幅图像执行运算链，按行带切分后并行处理；支持 8 位与 32 位浮点、1 到 4 通道，输出与输入同深度
+inline void run_pixel_ops(const cv::Mat& src, cv::Mat& dst, std::span<const pixel_op> ops)
+{
+    if (src.depth() != CV_8U && src.depth() != CV_32F)
+        throw std::invalid_argument("run_pixel_ops: 仅支持 CV_8U 与 CV_32F 图像");
+    int channels = src.channels();
+    int out = pixel_kernel::output_channels(channels, ops);
+    if (dst.rows != src.rows || dst.cols != src.cols || dst.type() != CV_MAKETYPE(src.depth(), out))
+        dst.create(src.rows, src.cols, CV_MAKETYPE(src.depth(), out));
+
+    int band = std::max(1, (64 << 10) / std::max(1, src.cols * channels * static_cast<int>(sizeof(float))));
+    tbb::parallel_for(tbb::blocked_range<int>(0, src.rows, band), [&](const tbb::blocked_range<int>& rows) { run_pixel_rows(src, dst, ops, rows.begin(), rows.end()); });
+}
+inline void run_pixel_ops(flow_context& ctx, output_port<cv::Mat> port, const cv::Mat& src, std::span<const pixel_op> ops)
+{
+    int out = pixel_kernel::output_channels(src.channels(), ops);
+    run_pixel_ops(src, output_mat(ctx, port, src.rows, src.cols, CV_MAKETYPE(src.depth(), out)), ops);
+}
+
+// 单输入单输出的逐像素节点；flow_program 会把相邻的此类节点融合成一次遍历，flow_tiler 按块执行时 halo 为 0。
+// 单独执行时也走同一套内核
+struct elementwise_node : tiled_node
+{
+    virtual pixel_op op() const = 0;
+    int output_type(int input_type) const override
+    {
+        pixel_op ops[] = { op() };
+        return CV_MAKETYPE(CV_MAT_DEPTH(input_type), pixel_kernel::output_channels(CV_MAT_CN(input_type), ops));
+    }
+    void process_tile(const cv::Mat& src, cv::Mat& dst) const override
+    {
+        if (src.depth() != CV_8U && src.depth() != CV_32F)
+            throw std::invalid_argument("run_pixel_ops: 仅支持 CV_8U 与 CV_32F 图像");
+        pixel_op ops[] = { op() };
+        run_pixel_rows(src, dst, ops, 0, src.rows);
+    }
+    void execute(flow_context& ctx) override
+    {
+        pixel_op ops[] = { op() };
+        run_pixel_ops(ctx, dst, ctx.input(src), ops);
+    }
+    std::optional<uint64_t> parameter_hash() const override { return op().hash(); }
+};
+
+struct scale_node : elementwise_node
+{
+private:
+    float scale = 1.0f;
+    float shift = 0.0f;
+
+public:
+    scale_node() = default;
+    scale_node(float scale, float shift) : scale(scale), shift(shift) {}
+    std::string describe() const override { return "x * scale + shift"; }
+    pixel_op op() const override { return pixel_op::affine(scale, shift); }
+    void set(float new_scale, float new_shift)
+    {
+        scale = new_scale;
+        shift = new_shift;
+        touch();
+    }
+};
+
+struct clamp_node : elementwise_node
+{
+private:
+    float low = 0.0f;
+    float high = 255.0f;
+
+public:
+    clamp_node() = default;
+    clamp_node(float low, float high) : low(low), high(high) {}
+    std::string describe() const override { return "clamp(x, low, high)"; }
+    pixel_op op() const override { return pixel_op::clamp(low, high); }
+    void set(float new_low, float new_high)
+    {
+        low = new_low;
+        high = new_high;
+        touch();
+    }
+};
+
+struct color_convert_node : elementwise_node
+{
+private:
+    pixel_op conversion = pixel_op::bgr_to_gray();
+
+public:
+    color_convert_node() = default;
+    explicit color_convert_node(pixel_op conversion) : conversion(conversion) {}
+    std::string describe() const override { return "channel mix"; }
+    pixel_op op() const override { return conversion; }
+    void set(pixel_op new_conversion)
+    {
+        conversion = new_conversion;
+        touch();
+    }
+};
@@ -0,0 +1,276 @@
+#pragma once
+#include <imgui.h>
+#include <implot.h>
+
+#include "flow-profile.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+// 节点耗时面板：在 main_render 回调中调用 render，每帧取出 profiler 的新记录。
+// 上方为最近几次执行的时间线（每行一个执行线程，每段一次节点执行，悬停查看详情，点击选中节点），
+// 下方为各节点的统计表与选中节点的耗时分布直方图。节点按 (图编号, 节点编号) 区分，一个 profiler 可同时采样多张图
+class flow_profile_panel
+{
+public:
+    using name_function = std::function<std::string(uint64_t graph, uint32_t node)>;
+
+private:
+    struct node_key
+    {
+        uint64_t graph = 0;
+        uint32_t node = 0;
+        auto operator<=>(const node_key&) const = default;
+    };
+
+    struct node_stats
+    {
+        std::vector<float> samples;
+        size_t next = 0;
+        size_t count = 0;
+        size_t hits = 0;
+        size_t misses = 0;
+        double wall_ms = 0;
+        double cpu_ms = 0;
+        uint64_t allocated_bytes = 0;
+    };
+
+    std::vector<flow_profile_record> incoming;
+    std::deque<flow_profile_record> timeline;
+    std::map<node_key, node_stats> nodes;
+    // 见过不止一张图时，无名字的节点标签带上图编号
+    uint64_t first_graph = 0;
+    bool multiple_graphs = false;
+    uint64_t latest_run = 0;
+    uint64_t lost = 0;
+    int runs_shown = 4;
+    size_t history = 512;
+    bool follow = true;
+    bool paused = false;
+    std::optional<node_key> selected;
+    // 面板自己的 ImPlot 上下文，在渲染线程上第一次 render 时创建，随面板析构
+    ImPlotContext* plot_context = nullptr;
+
+public:
+    flow_profile_panel() = default;
+    explicit flow_profile_panel(size_t history) : history(std::max<size_t>(history, 16)) {}
+    flow_profile_panel(const flow_profile_panel&) = delete;
+    flow_profile_panel& operator=(const flow_profile_panel&) = delete;
+    // 需在渲染线程不再调用 render 之后析构，如 runtime_visualizer 销毁之后
+    ~flow_profile_panel()
+    {
+        if (plot_context)
+            ImPlot::DestroyContext(plot_context);
+    }
+
+public:
+    void clear()
+    {
+        timeline.clear();
+        nodes.clear();
+        first_graph = 0;
+        multiple_graphs = false;
+        latest_run = 0;
+        selected.reset();
+    }
+
+    // name 把节点转成显示名称，如 [&](uint64_t id, uint32_t node) { return id == graph.id() ? graph.at(node)->describe() : ""; }；
+    // 为空或返回空串时显示编号
+    void render(flow_profiler& profiler, const name_function& name = {})
+    {
+        // runtime_visualizer 只创建了 ImGui 上下文；切换到面板自己的 ImPlot 上下文，结束时恢复原来的
+        auto previous_context = ImPlot::GetCurrentContext();
+        if (!plot_context)
+            plot_context = ImPlot::CreateContext();
+        ImPlot::SetCurrentContext(plot_context);
+
+        bool sampling = profiler.enabled();
+        if (ImGui::Checkbox("采样", &sampling))
+            profiler.set_enabled(sampling);
+        ImGui::SameLine();
+        ImGui::Checkbox("暂停", &paused);
+        ImGui::SameLine();
+        ImGui::Checkbox("跟随", &follow);
+        ImGui::SameLine();
+        if (ImGui::Button("清空"))
+            clear();
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(120);
+        ImGui::SliderInt("显示执行次数", &runs_shown, 1, 64);
+
+        if (!paused)
+        {
+            incoming.clear();
+            lost = profiler.drain(incoming);
+            for (auto& record : incoming)
+                accept(record);
+        }
+        while (!timeline.empty() && timeline.front().run + static_cast<uint64_t>(runs_shown) <= latest_run)
+            timeline.pop_front();
+        ImGui::Text("线程 %zu, 第 %llu 次执行, 丢失记录 %llu", profiler.threads(), static_cast<unsigned long long>(latest_run), static_cast<unsigned long long>(lost));
+
+        render_timeline(name);
+        render_table(name);
+        render_histogram(name);
+        ImPlot::SetCurrentContext(previous_context);
+    }
+
+private:
+    static node_key key(const flow_profile_record& record) { return { record.graph, record.node }; }
+    std::string label(const name_function& name, node_key id) const
+    {
+        auto text = name ? name(id.graph, id.node) : std::string();
+        if (!text.empty())
+            return text;
+        return (multiple_graphs ? "图 " + std::to_string(id.graph) + " #" : "#") + std::to_string(id.node);
+    }
+
+    void accept(const flow_profile_record& record)
+    {
+        latest_run = std::max(latest_run, record.run);
+        timeline.push_back(record);
+        if (first_graph == 0)
+            first_graph = record.graph;
+        multiple_graphs = multiple_graphs || record.graph != first_graph;
+        auto& stats = nodes[key(record)];
+        if (stats.samples.size() < history)
+            stats.samples.push_back(static_cast<float>(record.wall_ns / 1e6));
+        else
+            stats.samples[stats.next] = static_cast<float>(record.wall_ns / 1e6);
+        stats.next = (stats.next + 1) % history;
+        stats.count++;
+        stats.hits += record.cache == flow_profile_record::cache_state::hit;
+        stats.misses += record.cache == flow_profile_record::cache_state::miss;
+        stats.wall_ms += record.wall_ns / 1e6;
+        stats.cpu_ms += std::max<int64_t>(record.cpu_ns, 0) / 1e6;
+        stats.allocated_bytes += record.allocated_bytes;
+    }
+
+    // 甘特图：横轴为相对最早一条记录的毫秒数，纵轴为线程编号；异步节点只画边框，缓存命中的颜色减淡
+    void render_timeline(const name_function& name)
+    {
+        if (!ImPlot::BeginPlot("##timeline", ImVec2(-1, 220)))
+            return;
+        int64_t origin = INT64_MAX;
+        int64_t end = 0;
+        uint32_t threads = 1;
+        for (auto& record : timeline)
+        {
+            origin = std::min(origin, record.begin_ns);
+            end = std::max(end, record.begin_ns + record.wall_ns);
+            threads = std::max(threads, record.thread + 1);
+        }
+        if (timeline.empty())
+            origin = 0;
+        ImPlot::SetupAxes("ms", "线程", 0, ImPlotAxisFlags_Invert);
+        ImPlot::SetupAxesLimits(0, std::max((end - origin) / 1e6, 0.001), -0.5, threads - 0.5, follow ? ImPlotCond_Always : ImPlotCond_Once);
+
+        auto draw = ImPlot::GetPlotDrawList();
+        auto mouse = ImPlot::GetPlotMousePos();
+        const flow_profile_record* hovered = nullptr;
+        ImPlot::PushPlotClipRect();
+        for (auto& record : timeline)
+        {
+            double x0 = (record.begin_ns - origin) / 1e6;
+            double x1 = x0 + record.wall_ns / 1e6;
+            double y = record.thread;
+            auto color = ImPlot::GetColormapColor(static_cast<int>(record.node % static_cast<uint32_t>(ImPlot::GetColormapSize())));
+            if (record.cache == flow_profile_record::cache_state::hit)
+                color.w = 0.4f;
+            auto min = ImPlot::PlotToPixels(x0, y - 0.4);
+            auto max = ImPlot::PlotToPixels(x1, y + 0.4);
+            max.x = std::max(max.x, min.x + 1.0f);
+            if (record.async)
+                draw->AddRect(min, max, ImGui::GetColorU32(color), 0.0f, 0, 1.5f);
+            else
+                draw->AddRectFilled(min, max, ImGui::GetColorU32(color));
+            if (selected == key(record))
+                draw->AddRect(min, max, IM_COL32(255, 255, 255, 255));
+            if (ImPlot::IsPlotHovered() && mouse.x >= x0 && mouse.x <= x1 && mouse.y >= y - 0.4 && mouse.y <= y + 0.4)
+                hovered = &record;
+        }
+        ImPlot::PopPlotClipRect();
+
+        if (hovered)
+        {
+            ImGui::BeginTooltip();
+            ImGui::Text("%s", label(name, key(*hovered)).c_str());
+            ImGui::Text("第 %llu 次执行, 线程 %u", static_cast<unsigned long long>(hovered->run), hovered->thread);
+            if (hovered->async)
+                ImGui::Text("耗时 %.3f ms（异步，含等待）", hovered->wall_ns / 1e6);
+            else
+                ImGui::Text("耗时 %.3f ms, CPU %.3f ms", hovered->wall_ns / 1e6, hovered->cpu_ns / 1e6);
+            ImGui::Text("缓冲池与临时内存分配 %.1f KiB", hovered->allocated_bytes / 1024.0);
+            if (hovered->cache != flow_profile_record::cache_state::none)
+                ImGui::Text("结果缓存%s", hovered->cache == flow_profile_record::cache_state::hit ? "命中" : "未命中");
+            ImGui::EndTooltip();
+            if (ImGui::IsMouseClicked(ImGuiMouseButton_Left))
+                selected = key(*hovered);
+        }
+        ImPlot::EndPlot();
+    }
+
+    void render_table(const name_function& name)
+    {
+        constexpr auto flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_Resizable;
+        if (!ImGui::BeginTable("##nodes", 6, flags, ImVec2(-1, 180)))
+            return;
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn("节点");
+        ImGui::TableSetupColumn("次数");
+        ImGui::TableSetupColumn("平均 ms");
+        ImGui::TableSetupColumn("p95 ms");
+        ImGui::TableSetupColumn("CPU 平均 ms");
+        // 只统计引擎自己的分配器，节点直接 new 或 OpenCV 内部的分配不在其中
+        ImGui::TableSetupColumn("命中 / 未命中 / 平均缓冲池与临时内存分配");
+        ImGui::TableHeadersRow();
+        std::vector<float> sorted;
+        int row = 0;
+        for (auto& [id, stats] : nodes)
+        {
+            sorted.assign(stats.samples.begin(), stats.samples.end());
+            auto p95 = sorted.begin() + static_cast<ptrdiff_t>(sorted.size() * 95 / 100);
+            std::nth_element(sorted.begin(), p95, sorted.end());
+
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::PushID(row++);
+            if (ImGui::Selectable(label(name, id).c_str(), selected == id, ImGuiSelectableFlags_SpanAllColumns))
+                selected = id;
+            ImGui::PopID();
+            ImGui::TableNextColumn();
+            ImGui::Text("%zu", stats.count);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stats.wall_ms / stats.count);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", p95 != sorted.end() ? *p95 : 0.0f);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stats.cpu_ms / stats.count);
+            ImGui::TableNextColumn();
+            ImGui::Text("%zu / %zu / %.1f KiB", stats.hits, stats.misses, stats.allocated_bytes / 1024.0 / stats.count);
+        }
+        ImGui::EndTable();
+    }
+
+    void render_histogram(const name_function& name)
+    {
+        auto it = selected ? nodes.find(*selected) : nodes.end();
+        if (it == nodes.end())
+        {
+            ImGui::TextDisabled("选中节点后显示耗时分布");
+            return;
+        }
+        auto title = label(name, it->first) + " 最近 " + std::to_string(it->second.samples.size()) + " 次耗时 (ms)";
+        if (!ImPlot::BeginPlot(title.c_str(), ImVec2(-1, 200)))
+            return;
+        ImPlot::SetupAxes("ms", "次数", ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
+        ImPlot::PlotHistogram("##latency", it->second.samples.data(), static_cast<int>(it->second.samples.size()), ImPlotBin_Sturges);
+        ImPlot::EndPlot();
+    }
+};
@@ -0,0 +1,219 @@
+#pragma once
+#if defined(_WIN32) || defined(_WIN64)
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+    #undef WIN32_LEAN_AND_MEAN
+    #undef NOMINMAX
+#else
+    #include <time.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 引擎的分配器（临时内存、图像缓冲池）在当前线程上分配的字节数，执行器在节点前后取差值计入该节点
+inline thread_local uint64_t flow_thread_allocated_bytes = 0;
+inline void flow_count_allocation(size_t bytes)
+{
+    flow_thread_allocated_bytes += bytes;
+}
+
+// 当前线程占用的 CPU 时间；Windows 上的精度为调度时间片
+inline int64_t flow_thread_cpu_ns()
+{
+#if defined(_WIN32) || defined(_WIN64)
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+        return 0;
+    auto to_ns = [](FILETIME time) { return static_cast<int64_t>((static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 100; };
+    return to_ns(kernel) + to_ns(user);
+#else
+    timespec now{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1'000'000'000 + now.tv_nsec;
+#endif
+}
+
+// 一个节点的一次执行；异步节点的 wall_ns 含等待时间，cpu_ns 为 -1
+struct flow_profile_record
+{
+    enum class cache_state : uint8_t
+    {
+        none,
+        hit,
+        miss,
+    };
+
+    uint64_t run = 0;
+    uint32_t node = 0;
+    // 执行线程在 profiler 中的编号，从 0 开始连续分配
+    uint32_t thread = 0;
+    // 节点所属图的 flow_graph::id()，同一个 profiler 采样多张图时与 node 一起区分节点
+    uint64_t graph = 0;
+    // 相对 profiler 创建时刻
+    int64_t begin_ns = 0;
+    int64_t wall_ns = 0;
+    int64_t cpu_ns = 0;
+    // 只含引擎自己的分配器（图像缓冲池与临时内存），节点直接 new 或 OpenCV 内部的分配不计入
+    uint64_t allocated_bytes = 0;
+    cache_state cache = cache_state::none;
+    bool async = false;
+};
+
+// 节点执行记录的收集器：每个执行线程一个环形缓冲，写入只有一次原子存储，不加锁；读取方落后超过缓冲容量时最早的记录被覆盖并计入丢失。
+// 未开启采样时执行器只做一次判断
+class flow_profiler
+{
+public:
+    using clock = std::chrono::steady_clock;
+    using record_t = flow_profile_record;
+
+private:
+    // 单写单读：写入方为所属线程，读取方为 drain 的调用者，读完后核对 head 丢弃期间被覆盖的记录
+    struct ring_t
+    {
+        std::thread::id owner;
+        uint32_t index = 0;
+        std::unique_ptr<record_t[]> records;
+        size_t mask = 0;
+        std::atomic<uint64_t> head = 0;
+        uint64_t tail = 0;
+    };
+
+    static inline std::atomic<uint64_t> instance_counter = 0;
+    const uint64_t instance_id = ++instance_counter;
+    const clock::time_point epoch = clock::now();
+    const size_t ring_capacity;
+    std::atomic<bool> sampling = false;
+    std::atomic<uint64_t> run_counter = 0;
+
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<ring_t>> rings;
+    uint64_t lost = 0;
+
+public:
+    explicit flow_profiler(size_t records_per_thread = 4096) : ring_capacity(std::bit_ceil(std::max<size_t>(records_per_thread, 64))) {}
+    flow_profiler(const flow_profiler&) = delete;
+    flow_profiler& operator=(const flow_profiler&) = delete;
+
+public:
+    bool enabled() const { return sampling.load(std::memory_order_relaxed); }
+    void set_enabled(bool enabled) { sampling.store(enabled, std::memory_order_relaxed); }
+    // 执行器每次 run 开始时取一个新的编号，记录按编号归入各次执行
+    uint64_t begin_run() { return run_counter.fetch_add(1, std::memory_order_relaxed) + 1; }
+    int64_t now_ns() const { return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - epoch).count(); }
+    size_t threads() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return rings.size();
+    }
+
+    void record(record_t record)
+    {
+        auto& ring = local_ring();
+        record.thread = ring.index;
+        auto head = ring.head.load(std::memory_order_relaxed);
+        ring.records[head & ring.mask] = record;
+        ring.head.store(head + 1, std::memory_order_release);
+    }
+    // 把上次调用以来的新记录追加到 out，返回累计丢失的记录数；同一时刻只能有一个线程调用
+    uint64_t drain(std::vector<record_t>& out)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& ring : rings)
+        {
+            auto head = ring->head.load(std::memory_order_acquire);
+            auto first = std::max(ring->tail, head > ring_capacity ? head - ring_capacity : 0);
+            lost += first - ring->tail;
+            auto begin = out.size();
+            for (auto sequence = first; sequence < head; sequence++)
+                out.push_back(ring->records[sequence & ring->mask]);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            // head 为 now 时写入方可能正在覆盖第 now 条记录所在的槽位，即第 now - capacity 条，它也要算作已被覆盖
+            auto now = ring->head.load(std::memory_order_relaxed);
+            auto overwritten = now + 1 > ring_capacity ? now + 1 - ring_capacity : 0;
+            if (overwritten > first)
+            {
+                auto torn = std::min(overwritten, head) - first;
+                out.erase(out.begin() + static_cast<ptrdiff_t>(begin), out.begin() + static_cast<ptrdiff_t>(begin + torn));
+                lost += torn;
+            }
+            ring->tail = head;
+        }
+        return lost;
+    }
+
+private:
+    ring_t& local_ring()
+    {
+        thread_local uint64_t cached_instance = 0;
+        thread_local ring_t* cached_ring = nullptr;
+        if (cached_instance == instance_id)
+            return *cached_ring;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto self = std::this_thread::get_id();
+        auto it = std::find_if(rings.begin(), rings.end(), [&](const std::unique_ptr<ring_t>& ring) { return ring->owner == self; });
+        if (it == rings.end())
+        {
+            auto ring = std::make_unique<ring_t>();
+            ring->owner = self;
+            ring->index = static_cast<uint32_t>(rings.size());
+            ring->records = std::make_unique<record_t[]>(ring_capacity);
+            ring->mask = ring_capacity - 1;
+            it = rings.insert(rings.end(), std::move(ring));
+        }
+        cached_instance = instance_id;
+        cached_ring = it->get();
+        return *cached_ring;
+    }
+};
+
+// 在节点执行前后采样，析构时写入记录；profiler 为空时不做任何事
+class flow_profile_scope
+{
+    flow_profiler* profiler;
+    flow_profile_record record;
+    int64_t cpu_begin = 0;
+    uint64_t allocated_begin = 0;
+
+public:
+    flow_profile_scope(flow_profiler* profiler, uint64_t run, uint64_t graph, uint32_t node) : profiler(profiler)
+    {
+        if (!profiler)
+            return;
+        record.run = run;
+        record.node = node;
+        record.graph = graph;
+        record.begin_ns = profiler->now_ns();
+        cpu_begin = flow_thread_cpu_ns();
+        allocated_begin = flow_thread_allocated_bytes;
+    }
+    flow_profile_scope(const flow_profile_scope&) = delete;
+    flow_profile_scope& operator=(const flow_profile_scope&) = delete;
+    ~flow_profile_scope()
+    {
+        if (!profiler)
+            return;
+        record.wall_ns = profiler->now_ns() - record.begin_ns;
+        record.cpu_ns = flow_thread_cpu_ns() - cpu_begin;
+        record.allocated_bytes = flow_thread_allocated_bytes - allocated_begin;
+        profiler->record(record);
+    }
+
+public:
+    bool active() const { return profiler != nullptr; }
+    void set_cache(flow_profile_record::cache_state cache) { record.cache = cache; }
+};
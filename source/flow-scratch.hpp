@@ -0,0 +1,90 @@
+#pragma once
+#include "flow-profile.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+// 节点执行期间的临时内存（轮廓点集、关键点、字符串、临时 vector 等）：单调分配、不单独释放，由执行器在每次求值的最后一步结束后整体回收。
+// 首块缓冲用完后向全局堆申请新块，回收时按上一轮的用量扩大首块，图的运行稳定之后临时内存不再访问全局堆。
+// 不是线程安全的，执行器为每个工作线程准备一个
+class flow_scratch_arena : public std::pmr::memory_resource
+{
+public:
+    struct stats_t
+    {
+        size_t bytes_used = 0;
+        size_t peak_bytes_used = 0;
+        size_t capacity = 0;
+        size_t grows = 0;
+    };
+
+private:
+    // 统计首块缓冲之外向全局堆申请的次数与字节数
+    class upstream_t : public std::pmr::memory_resource
+    {
+    public:
+        size_t allocations = 0;
+        size_t bytes = 0;
+
+    private:
+        void* do_allocate(size_t size, size_t alignment) override
+        {
+            allocations++;
+            bytes += size;
+            return std::pmr::new_delete_resource()->allocate(size, alignment);
+        }
+        void do_deallocate(void* pointer, size_t size, size_t alignment) override { std::pmr::new_delete_resource()->deallocate(pointer, size, alignment); }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+    };
+
+    std::unique_ptr<std::byte[]> initial;
+    upstream_t upstream;
+    std::optional<std::pmr::monotonic_buffer_resource> monotonic;
+    stats_t counters;
+
+public:
+    explicit flow_scratch_arena(size_t initial_bytes = 64 << 10)
+    {
+        counters.capacity = std::max<size_t>(initial_bytes, 1024);
+        initial = std::make_unique_for_overwrite<std::byte[]>(counters.capacity);
+        monotonic.emplace(initial.get(), counters.capacity, &upstream);
+    }
+    flow_scratch_arena(const flow_scratch_arena&) = delete;
+    flow_scratch_arena& operator=(const flow_scratch_arena&) = delete;
+
+public:
+    stats_t stats() const { return counters; }
+    // 回收本轮分配的全部内存，之前取得的指针全部失效
+    void reset()
+    {
+        if (counters.bytes_used == 0 && upstream.allocations == 0)
+            return;
+        bool overflowed = upstream.allocations > 0;
+        monotonic.reset();
+        if (overflowed)
+        {
+            counters.grows++;
+            counters.capacity = std::bit_ceil(std::max(counters.capacity * 2, counters.capacity + upstream.bytes));
+            initial = std::make_unique_for_overwrite<std::byte[]>(counters.capacity);
+        }
+        upstream.allocations = 0;
+        upstream.bytes = 0;
+        counters.bytes_used = 0;
+        monotonic.emplace(initial.get(), counters.capacity, &upstream);
+    }
+
+private:
+    void* do_allocate(size_t size, size_t alignment) override
+    {
+        counters.bytes_used += size;
+        flow_count_allocation(size);
+        counters.peak_bytes_used = std::max(counters.peak_bytes_used, counters.bytes_used);
+        return monotonic->allocate(size, alignment);
+    }
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
@@ -0,0 +1,386 @@
+#pragma once
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/task_arena.h>
+
+#include "flow.hpp"
+
+#include <algorithm>
+#include <any>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// 流水线执行：每次 push 放入一帧，同一节点按帧序串行处理，不同节点可同时处理不同的帧，
+// 第 N+1 帧可在第 N 帧仍处于后续阶段时进入前面的节点。每帧的输出单独存放，最多同时存在 max_in_flight 帧；
+// 每条边上已产出而下游尚未处理的帧数不超过 edge_capacity。背压策略：
+//   block       上游在边满时等待，push 在在途帧数达到上限时等待
+//   drop_oldest 上游不等待，边满时丢弃该边上最早的一帧，push 在在途帧数满时丢弃最早一帧没有节点正在处理的帧；
+//               被丢弃的帧不再执行也不回调
+// 流运行期间节点图的拓扑不能修改。节点的临时内存在每次处理一帧结束后回收
+class flow_stream
+{
+public:
+    using index_t = flow_graph::index_t;
+    using clock = std::chrono::steady_clock;
+    using duration = std::chrono::nanoseconds;
+
+    enum class backpressure
+    {
+        block,
+        drop_oldest,
+    };
+    struct options_t
+    {
+        size_t max_in_flight = 4;
+        size_t edge_capacity = 2;
+        backpressure policy = backpressure::block;
+        int concurrency = tbb::task_arena::automatic;
+    };
+
+    // occupancy 为节点忙碌时间占流运行时间的比例，接近 1 的节点即为瓶颈；queued 为输入已就绪等待处理的帧数，
+    // blocked 为输入就绪却因下游边满而等待的时间
+    struct stage_stats
+    {
+        index_t node = flow_graph::npos;
+        size_t processed = 0;
+        size_t dropped = 0;
+        size_t queued = 0;
+        duration busy = {};
+        duration blocked = {};
+        double occupancy = 0;
+    };
+    struct stream_stats
+    {
+        uint64_t admitted = 0;
+        uint64_t delivered = 0;
+        uint64_t dropped = 0;
+        duration elapsed = {};
+        std::vector<stage_stats> stages;
+    };
+
+    // 交付给回调的一帧输出，只在回调期间有效
+    class frame_view
+    {
+        const std::vector<std::vector<std::any>>& values;
+
+    public:
+        const uint64_t sequence;
+        frame_view(const std::vector<std::vector<std::any>>& values, uint64_t sequence) : values(values), sequence(sequence) {}
+        template <class T> const T* value(index_t id, output_port<T> port) const
+        {
+            if (id >= values.size() || port.index >= values[id].size())
+                return nullptr;
+            return std::any_cast<T>(&values[id][port.index]);
+        }
+    };
+
+private:
+    struct stage_t
+    {
+        uint64_t next = 0;
+        bool running = false;
+        size_t processed = 0;
+        size_t dropped = 0;
+        duration busy = {};
+        duration blocked = {};
+        std::optional<clock::time_point> blocked_since;
+    };
+    struct frame_t
+    {
+        std::vector<std::vector<std::any>> values;
+        bool dropped = false;
+    };
+
+    flow_graph& graph;
+    options_t options;
+    std::vector<index_t> order;
+    std::vector<index_t> sinks;
+    std::vector<stage_t> stages;
+    std::vector<frame_t> frames;
+    std::function<void(const frame_view&)> on_frame;
+    std::atomic<flow_profiler*> profiler = nullptr;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    uint64_t admitted = 0;
+    uint64_t completed = 0;
+    uint64_t dropped_frames = 0;
+    bool delivering = false;
+    std::exception_ptr error;
+    std::optional<clock::time_point> started;
+
+    tbb::task_arena arena;
+    tbb::enumerable_thread_specific<flow_scratch_arena> scratch;
+    size_t running = 0;
+
+public:
+    // on_frame 在帧的全部末端节点完成后按帧序调用，调用期间该帧的输出缓冲不会被复用。
+    // 节点任务以 enqueue 方式提交且不为调用线程保留槽位，push 与 wait 阻塞时节点仍由工作线程推进
+    flow_stream(flow_graph& graph, options_t options, std::function<void(const frame_view&)> on_frame = {})
+        : graph(graph), options(options), on_frame(std::move(on_frame)), arena(options.concurrency, 0)
+    {
+        this->options.max_in_flight = std::max<size_t>(this->options.max_in_flight, 1);
+        this->options.edge_capacity = std::max<size_t>(this->options.edge_capacity, 1);
+        auto planned = graph.plan();
+        order.assign(planned.begin(), planned.end());
+        stages.resize(graph.capacity());
+        frames.resize(this->options.max_in_flight);
+        for (auto& frame : frames)
+        {
+            frame.values.resize(graph.capacity());
+            for (auto id : order)
+                frame.values[id].resize(graph.at(id)->outputs().size());
+        }
+        for (auto id : order)
+            if (graph.slot(id).successors.empty())
+                sinks.push_back(id);
+    }
+    flow_stream(const flow_stream&) = delete;
+    flow_stream& operator=(const flow_stream&) = delete;
+    ~flow_stream()
+    {
+        try
+        {
+            wait();
+        }
+        catch (...)
+        {
+        }
+    }
+
+public:
+    // 放入一帧并返回其序号；根节点随后为这一帧产出数据。节点抛出的异常会丢弃所在帧并在下一次 push 或 wait 时重新抛出
+    uint64_t push()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        rethrow();
+        if (!started)
+            started = clock::now();
+        if (options.policy == backpressure::drop_oldest && admitted - completed >= options.max_in_flight)
+        {
+            for (auto sequence = completed; sequence < admitted; sequence++)
+                if (!frame(sequence).dropped && !executing(sequence))
+                {
+                    frame(sequence).dropped = true;
+                    break;
+                }
+            auto ready = pump();
+            deliver(lock);
+            lock.unlock();
+            launch(ready);
+            lock.lock();
+        }
+        changed.wait(lock, [&] { return admitted - completed < options.max_in_flight || error; });
+        rethrow();
+
+        auto sequence = admitted++;
+        frame(sequence).dropped = false;
+        auto ready = pump();
+        deliver(lock);
+        lock.unlock();
+        launch(ready);
+        return sequence;
+    }
+    // 等待已放入的帧全部完成或被丢弃
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&] { return completed == admitted && running == 0; });
+        rethrow();
+    }
+
+    // 开启采样时每个节点对每帧的处理写入 profiler，记录的 run 为帧序号加一
+    void set_profiler(flow_profiler* target) { profiler.store(target, std::memory_order_relaxed); }
+
+    stream_stats stats()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stream_stats result;
+        result.admitted = admitted;
+        result.delivered = completed - dropped_frames;
+        result.dropped = dropped_frames;
+        result.elapsed = started ? std::chrono::duration_cast<duration>(clock::now() - *started) : duration{};
+        for (auto id : order)
+        {
+            auto& stage = stages[id];
+            stage_stats stats{ id, stage.processed, stage.dropped, 0, stage.busy, stage.blocked, 0.0 };
+            for (auto sequence = stage.next; sequence < admitted; sequence++)
+                if (!frame(sequence).dropped && inputs_ready(id, sequence))
+                    stats.queued++;
+            if (stage.running && stats.queued > 0)
+                stats.queued--;
+            if (result.elapsed.count() > 0)
+                stats.occupancy = static_cast<double>(stage.busy.count()) / static_cast<double>(result.elapsed.count());
+            result.stages.push_back(stats);
+        }
+        return result;
+    }
+
+private:
+    frame_t& frame(uint64_t sequence) { return frames[sequence % frames.size()]; }
+    void rethrow()
+    {
+        if (error)
+            std::rethrow_exception(std::exchange(error, nullptr));
+    }
+    bool executing(uint64_t sequence) const
+    {
+        return std::any_of(order.begin(), order.end(), [&](index_t id) { return stages[id].running && stages[id].next == sequence; });
+    }
+    bool inputs_ready(index_t id, uint64_t sequence) const
+    {
+        auto& sources = graph.slot(id).sources;
+        return std::all_of(sources.begin(), sources.end(), [&](const flow_graph::source_t& source) { return source.node == flow_graph::npos || stages[source.node].next > sequence; });
+    }
+    bool edges_full(index_t id, uint64_t sequence) const
+    {
+        auto& successors = graph.slot(id).successors;
+        return std::any_of(successors.begin(), successors.end(), [&](index_t successor) { return sequence + 1 - stages[successor].next > options.edge_capacity; });
+    }
+
+    // 在锁内找出所有可以开始的 (节点, 帧)，并让节点跳过已丢弃的帧；跳过同样要等上游越过该帧，
+    // 保证末端节点越过某帧时所有节点都已越过，帧缓冲才能被复用
+    std::vector<std::pair<index_t, uint64_t>> pump()
+    {
+        std::vector<std::pair<index_t, uint64_t>> ready;
+        for (bool progressed = true; progressed;)
+        {
+            progressed = false;
+            for (auto id : order)
+            {
+                auto& stage = stages[id];
+                if (stage.running)
+                    continue;
+                while (stage.next < admitted && frame(stage.next).dropped && inputs_ready(id, stage.next))
+                {
+                    stage.next++;
+                    stage.dropped++;
+                    progressed = true;
+                }
+                if (stage.next >= admitted || !inputs_ready(id, stage.next))
+                    continue;
+                if (options.policy == backpressure::block && edges_full(id, stage.next))
+                {
+                    if (!stage.blocked_since)
+                        stage.blocked_since = clock::now();
+                    continue;
+                }
+                if (stage.blocked_since)
+                    stage.blocked += std::chrono::duration_cast<duration>(clock::now() - *std::exchange(stage.blocked_since, std::nullopt));
+                stage.running = true;
+                running++;
+                ready.emplace_back(id, stage.next);
+            }
+        }
+        return ready;
+    }
+    void launch(const std::vector<std::pair<index_t, uint64_t>>& ready)
+    {
+        for (auto [id, sequence] : ready)
+            arena.enqueue([this, id, sequence] { process(id, sequence); });
+    }
+    void process(index_t id, uint64_t sequence)
+    {
+        auto& current = frame(sequence);
+        auto& slot = graph.slot(id);
+        std::vector<const std::any*> inputs(slot.sources.size(), nullptr);
+        for (size_t i = 0; i < inputs.size(); i++)
+            if (slot.sources[i].node != flow_graph::npos)
+                inputs[i] = &current.values[slot.sources[i].node][slot.sources[i].port];
+
+        std::exception_ptr failure;
+        auto& local = scratch.local();
+        auto sampling = profiler.load(std::memory_order_relaxed);
+        sampling = sampling && sampling->enabled() ? sampling : nullptr;
+        auto begin = clock::now();
+        try
+        {
+            flow_profile_scope sample(sampling, sequence + 1, graph.id(), id);
+            flow_context ctx(inputs, current.values[id], &local);
+            slot.instance->execute(ctx);
+        }
+        catch (...)
+        {
+            failure = std::current_exception();
+        }
+        auto end = clock::now();
+        local.reset();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        auto& stage = stages[id];
+        stage.running = false;
+        stage.next++;
+        stage.processed++;
+        stage.busy += std::chrono::duration_cast<duration>(end - begin);
+        if (failure)
+        {
+            current.dropped = true;
+            if (!error)
+                error = failure;
+        }
+        if (options.policy == backpressure::drop_oldest)
+            drop_overflow(id, sequence);
+        auto ready = pump();
+        deliver(lock);
+        running--;
+        changed.notify_all();
+        lock.unlock();
+        launch(ready);
+    }
+    // 节点产出 sequence 后，若某条出边上等待的帧超过容量，丢弃其中最早的帧
+    void drop_overflow(index_t id, uint64_t sequence)
+    {
+        for (auto successor : graph.slot(id).successors)
+        {
+            auto& stage = stages[successor];
+            size_t waiting = 0;
+            for (auto pending = stage.next + (stage.running ? 1 : 0); pending <= sequence; pending++)
+                waiting += !frame(pending).dropped;
+            for (auto pending = stage.next + (stage.running ? 1 : 0); waiting > options.edge_capacity && pending <= sequence; pending++)
+                if (!frame(pending).dropped)
+                {
+                    frame(pending).dropped = true;
+                    waiting--;
+                }
+        }
+    }
+    // 按帧序交付已完成的帧；同一时刻只有一个线程在锁外调用回调
+    void deliver(std::unique_lock<std::mutex>& lock)
+    {
+        while (!delivering && completed < admitted)
+        {
+            auto sequence = completed;
+            if (!std::all_of(sinks.begin(), sinks.end(), [&](index_t id) { return stages[id].next > sequence; }))
+                break;
+            bool dropped = frame(sequence).dropped;
+            if (!dropped && on_frame)
+            {
+                std::exception_ptr failure;
+                delivering = true;
+                lock.unlock();
+                try
+                {
+                    on_frame(frame_view(frame(sequence).values, sequence));
+                }
+                catch (...)
+                {
+                    failure = std::current_exception();
+                }
+                lock.lock();
+                delivering = false;
+                if (failure && !error)
+                    error = failure;
+            }
+            completed++;
+            dropped_frames += dropped;
+            changed.notify_all();
+        }
+    }
+};
@@ -0,0 +1,384 @@
+#pragma once
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+
+#include "flow-mat.hpp"
+#include "flow.hpp"
+
+#include <algorithm>
+#include <any>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+// 可分块执行的单输入单输出图像节点：输出保持输入的尺寸，每个输出像素只依赖输入中以它为中心、半径为 halo 的邻域
+struct tiled_node : node
+{
+    input_port<cv::Mat> src = add_input<cv::Mat>("src");
+    output_port<cv::Mat> dst = add_output<cv::Mat>("dst");
+
+    virtual int halo() const { return 0; }
+    virtual int output_type(int input_type) const { return input_type; }
+    // src 比 dst 四周各多 halo 个像素，图像边界之外的部分已按 BORDER_REFLECT_101 补齐，src 可能是更大图像的 ROI；
+    // dst 已按 output_type 分配好，可能是输出图像的 ROI，不能重新分配
+    virtual void process_tile(const cv::Mat& src, cv::Mat& dst) const = 0;
+
+    // 整幅图像作为一块处理
+    void execute(flow_context& ctx) override
+    {
+        auto& input = ctx.input(src);
+        auto& output = output_mat(ctx, dst, input.rows, input.cols, output_type(input.type()));
+        int border = halo();
+        if (border == 0)
+        {
+            process_tile(input, output);
+            return;
+        }
+        cv::Mat padded;
+        cv::copyMakeBorder(input, padded, border, border, border, border, cv::BORDER_REFLECT_101 | cv::BORDER_ISOLATED);
+        process_tile(padded, output);
+    }
+};
+
+struct box_blur_node : tiled_node
+{
+private:
+    int radius = 1;
+
+public:
+    box_blur_node() = default;
+    explicit box_blur_node(int radius) : radius(std::max(radius, 0)) {}
+    std::string describe() const override { return "box blur"; }
+    int halo() const override { return radius; }
+    std::optional<uint64_t> parameter_hash() const override { return static_cast<uint64_t>(radius); }
+    // 滤波只读取 ROI 外 halo 以内的真实像素，结果与对整幅图像按 BORDER_REFLECT_101 滤波一致
+    void process_tile(const cv::Mat& src, cv::Mat& dst) const override
+    {
+        cv::blur(src(cv::Rect(radius, radius, dst.cols, dst.rows)), dst, cv::Size(radius * 2 + 1, radius * 2 + 1), cv::Point(-1, -1), cv::BORDER_REFLECT_101);
+    }
+    void execute(flow_context& ctx) override
+    {
+        auto& input = ctx.input(src);
+        cv::blur(input, output_mat(ctx, dst, input.rows, input.cols, input.type()), cv::Size(radius * 2 + 1, radius * 2 + 1), cv::Point(-1, -1), cv::BORDER_REFLECT_101);
+    }
+    void set(int new_radius)
+    {
+        radius = std::max(new_radius, 0);
+        touch();
+    }
+};
+
+struct gaussian_blur_node : tiled_node
+{
+private:
+    double sigma = 1.0;
+
+public:
+    gaussian_blur_node() = default;
+    explicit gaussian_blur_node(double sigma) : sigma(std::max(sigma, 0.1)) {}
+    std::string describe() const override { return "gaussian blur"; }
+    // 核半径取 4 sigma 向上取整
+    int halo() const override { return static_cast<int>(std::ceil(sigma * 4)); }
+    std::optional<uint64_t> parameter_hash() const override { return std::bit_cast<uint64_t>(sigma); }
+    void process_tile(const cv::Mat& src, cv::Mat& dst) const override
+    {
+        int radius = halo();
+        cv::GaussianBlur(src(cv::Rect(radius, radius, dst.cols, dst.rows)), dst, cv::Size(radius * 2 + 1, radius * 2 + 1), sigma, sigma, cv::BORDER_REFLECT_101);
+    }
+    void execute(flow_context& ctx) override
+    {
+        auto& input = ctx.input(src);
+        int radius = halo();
+        cv::GaussianBlur(input, output_mat(ctx, dst, input.rows, input.cols, input.type()), cv::Size(radius * 2 + 1, radius * 2 + 1), sigma, sigma, cv::BORDER_REFLECT_101);
+    }
+    void set(double new_sigma)
+    {
+        sigma = std::max(new_sigma, 0.1);
+        touch();
+    }
+};
+
+// 分块执行：相连的 tiled_node 组成一个区域（以输入来自区域外的节点为根的树），区域按块遍历，每块依次流过区域内全部节点，
+// 中间结果只存在于每个线程的分块缓冲里，只有输出离开区域或没有下游的节点才生成整幅图像。
+// 每个节点在块的四周多算 margin 个像素，margin 为下游各条路径上 halo 之和的最大值，保证下游滤波读到的邻域都是真实数据；
+// 图像边界处按 BORDER_REFLECT_101 补齐，结果与逐节点处理整幅图像一致。
+// 同时处理的块数不超过并发数，峰值内存为 并发数 x 每块工作集，而不是每个中间结果一整幅图像。其它节点按拓扑序逐个执行
+class flow_tiler
+{
+public:
+    using index_t = flow_graph::index_t;
+
+    struct options_t
+    {
+        // 每块工作集（区域内全部节点的块缓冲）的目标字节数，tile_size 为 0 时据此推算块边长
+        size_t tile_bytes = 256ull << 10;
+        int tile_size = 0;
+        int concurrency = tbb::task_arena::automatic;
+    };
+    struct stats_t
+    {
+        size_t regions = 0;
+        size_t tiles = 0;
+        int tile_size = 0;
+        size_t scratch_bytes = 0;
+    };
+
+private:
+    struct region_t
+    {
+        uint32_t begin = 0;
+        uint32_t size = 0;
+    };
+    // region 为 npos 表示普通节点
+    struct step_t
+    {
+        index_t node = flow_graph::npos;
+        uint32_t region = flow_graph::npos;
+    };
+    // 区域内的节点按拓扑序存放；source 为区域内上游在区域中的下标，根节点为 npos
+    struct member_t
+    {
+        index_t node = flow_graph::npos;
+        uint32_t source = flow_graph::npos;
+        int margin = 0;
+        bool output = false;
+    };
+    // 每个线程的分块缓冲，按区域内下标存放；rect 为 view 在整幅图像中的位置
+    struct scratch_t
+    {
+        std::vector<cv::Mat> buffers;
+        std::vector<cv::Mat> views;
+        std::vector<cv::Rect> rects;
+        cv::Mat padded;
+    };
+
+    options_t options;
+    tbb::task_arena arena;
+    uint64_t compiled_version = 0;
+    std::vector<step_t> steps;
+    std::vector<region_t> regions;
+    std::vector<member_t> members;
+    tbb::enumerable_thread_specific<scratch_t> scratch;
+    flow_scratch_arena transient;
+    stats_t counters;
+
+public:
+    flow_tiler() : flow_tiler(options_t{}) {}
+    explicit flow_tiler(options_t options) : options(options), arena(options.concurrency) {}
+
+public:
+    bool compiled(const flow_graph& graph) const { return compiled_version == graph.topology_version(); }
+    stats_t stats() const { return counters; }
+
+    void compile(flow_graph& graph)
+    {
+        auto order = graph.plan();
+        steps.clear();
+        regions.clear();
+        members.clear();
+        std::vector<uint32_t> region_of(graph.capacity(), flow_graph::npos);
+        std::vector<std::vector<index_t>> region_nodes;
+        for (auto id : order)
+        {
+            auto instance = tiled(graph, id);
+            if (!instance)
+            {
+                steps.push_back({ id });
+                continue;
+            }
+            auto source = graph.slot(id).sources[instance->src.index].node;
+            if (source != flow_graph::npos && region_of[source] != flow_graph::npos)
+                region_of[id] = region_of[source];
+            else
+            {
+                region_of[id] = static_cast<uint32_t>(region_nodes.size());
+                steps.push_back({ id, region_of[id] });
+                region_nodes.emplace_back();
+            }
+            region_nodes[region_of[id]].push_back(id);
+        }
+
+        // 区域成员连续存放，各区域内保持拓扑序；margin 从下游往上游累加
+        std::vector<uint32_t> member_of(graph.capacity(), flow_graph::npos);
+        for (uint32_t region = 0; region < region_nodes.size(); region++)
+        {
+            region_t range{ static_cast<uint32_t>(members.size()), static_cast<uint32_t>(region_nodes[region].size()) };
+            for (auto id : region_nodes[region])
+            {
+                auto source = graph.slot(id).sources[tiled(graph, id)->src.index].node;
+                auto& successors = graph.slot(id).successors;
+                member_t member{ id };
+                if (id != region_nodes[region].front())
+                    member.source = member_of[source] - range.begin;
+                member.output = successors.empty() || std::any_of(successors.begin(), successors.end(), [&](index_t successor) { return region_of[successor] != region; });
+                member_of[id] = static_cast<uint32_t>(members.size());
+                members.push_back(member);
+            }
+            auto region_members = std::span<member_t>(members).subspan(range.begin, range.size);
+            for (auto it = region_members.rbegin(); it != region_members.rend(); it++)
+                if (it->source != flow_graph::npos)
+                {
+                    auto& source = region_members[it->source];
+                    source.margin = std::max(source.margin, it->margin + tiled(graph, it->node)->halo());
+                }
+            regions.push_back(range);
+        }
+        compiled_version = graph.topology_version();
+    }
+
+    // 拓扑变化后自动重新编译；节点抛出的异常直接传给调用方。区域外节点的临时内存在最后一步结束后
+    // （包括因异常退出时）整体回收
+    void run(flow_graph& graph)
+    {
+        if (!compiled(graph))
+            compile(graph);
+        struct scratch_guard
+        {
+            flow_scratch_arena* arena;
+            ~scratch_guard() { arena->reset(); }
+        } guard{ &transient };
+        counters = { regions.size() };
+        for (auto& step : steps)
+        {
+            if (step.region == flow_graph::npos)
+            {
+                graph.execute(step.node, nullptr, &transient);
+                continue;
+            }
+            run_region(graph, std::span<member_t>(members).subspan(regions[step.region].begin, regions[step.region].size));
+        }
+        for (auto& local : scratch)
+        {
+            for (auto& buffer : local.buffers)
+                counters.scratch_bytes += buffer.total() * buffer.elemSize();
+            counters.scratch_bytes += local.padded.total() * local.padded.elemSize();
+        }
+    }
+
+private:
+    static tiled_node* tiled(const flow_graph& graph, index_t id) { return dynamic_cast<tiled_node*>(graph.at(id).get()); }
+    static cv::Rect expand(cv::Rect rect, int border) { return { rect.x - border, rect.y - border, rect.width + border * 2, rect.height + border * 2 }; }
+
+    int tile_size(flow_graph& graph, std::span<const member_t> region, int input_type) const
+    {
+        if (options.tile_size > 0)
+            return options.tile_size;
+        size_t pixel_bytes = CV_ELEM_SIZE(input_type);
+        int halo = 0;
+        for (auto& member : region)
+        {
+            auto instance = tiled(graph, member.node);
+            input_type = instance->output_type(input_type);
+            pixel_bytes += CV_ELEM_SIZE(input_type);
+            halo = std::max(halo, member.margin + instance->halo());
+        }
+        int side = static_cast<int>(std::sqrt(static_cast<double>(options.tile_bytes) / static_cast<double>(pixel_bytes))) / 16 * 16;
+        // 半径很大时下限可能超过 2048，此时以下限为准
+        int low = std::max(32, halo * 4);
+        return std::clamp(side, low, std::max(low, 2048));
+    }
+
+    void run_region(flow_graph& graph, std::span<const member_t> region)
+    {
+        auto root = tiled(graph, region.front().node);
+        auto input = graph.input_value(region.front().node, root->src.index);
+        auto image = input ? std::any_cast<cv::Mat>(input) : nullptr;
+        if (!image || image->empty())
+            throw std::logic_error("flow_tiler: 分块区域的输入端口未连接或上游没有产出");
+
+        // 输出节点先分配整幅图像，类型沿区域逐级推出
+        std::vector<int> types(region.size());
+        std::vector<cv::Mat*> outputs(region.size(), nullptr);
+        for (size_t i = 0; i < region.size(); i++)
+        {
+            auto instance = tiled(graph, region[i].node);
+            int input_type = region[i].source == flow_graph::npos ? image->type() : types[region[i].source];
+            types[i] = instance->output_type(input_type);
+            if (region[i].output)
+            {
+                flow_context ctx({}, graph.output_values(region[i].node));
+                outputs[i] = &output_mat(ctx, instance->dst, image->rows, image->cols, types[i]);
+            }
+        }
+
+        int side = tile_size(graph, region, image->type());
+        int columns = (image->cols + side - 1) / side;
+        int tiles = columns * ((image->rows + side - 1) / side);
+        cv::Rect bounds(0, 0, image->cols, image->rows);
+        counters.tiles += tiles;
+        counters.tile_size = side;
+
+        arena.execute([&] {
+            tbb::parallel_for(tbb::blocked_range<int>(0, tiles, 1), [&](const tbb::blocked_range<int>& range) {
+                auto& local = scratch.local();
+                if (local.buffers.size() < region.size())
+                {
+                    local.buffers.resize(region.size());
+                    local.views.resize(region.size());
+                    local.rects.resize(region.size());
+                    for (auto& buffer : local.buffers)
+                        buffer.allocator = &mat_buffer_pool::instance();
+                    local.padded.allocator = &mat_buffer_pool::instance();
+                }
+                for (int tile = range.begin(); tile < range.end(); tile++)
+                {
+                    cv::Rect core(tile % columns * side, tile / columns * side, side, side);
+                    run_tile(graph, region, types, outputs, *image, core & bounds, bounds, local);
+                }
+            });
+        });
+
+        for (size_t i = 0; i < region.size(); i++)
+        {
+            if (region[i].output)
+                graph.mark_evaluated(region[i].node);
+            else
+                graph.mark_elided(region[i].node);
+        }
+    }
+
+    void run_tile(flow_graph& graph, std::span<const member_t> region, std::span<const int> types, std::span<cv::Mat* const> outputs, const cv::Mat& image, cv::Rect core, cv::Rect bounds,
+                  scratch_t& local)
+    {
+        for (size_t i = 0; i < region.size(); i++)
+        {
+            auto instance = tiled(graph, region[i].node);
+            auto rect = expand(core, region[i].margin) & bounds;
+            int border = instance->halo();
+
+            // 输入：整幅输入图像或上游的分块结果中覆盖 rect 四周 halo 的部分，越出图像的部分镜像补齐
+            auto need = expand(rect, border);
+            auto inside = need & bounds;
+            bool from_image = region[i].source == flow_graph::npos;
+            auto& available = from_image ? bounds : local.rects[region[i].source];
+            cv::Mat view = (from_image ? image : local.views[region[i].source])(inside - available.tl());
+            cv::Mat src = view;
+            if (need != inside)
+            {
+                cv::copyMakeBorder(view, local.padded, inside.y - need.y, need.br().y - inside.br().y, inside.x - need.x, need.br().x - inside.br().x,
+                                   cv::BORDER_REFLECT_101 | cv::BORDER_ISOLATED);
+                src = local.padded;
+            }
+
+            // 输出：不需要多算 margin 的输出节点直接写入整幅图像，其余写入本线程的分块缓冲
+            if (outputs[i] && region[i].margin == 0)
+                local.views[i] = (*outputs[i])(rect);
+            else
+            {
+                local.buffers[i].create(rect.size(), types[i]);
+                local.views[i] = local.buffers[i];
+            }
+            local.rects[i] = rect;
+            instance->process_tile(src, local.views[i]);
+            if (outputs[i] && region[i].margin > 0)
+                local.views[i](core - rect.tl()).copyTo((*outputs[i])(core));
+        }
+    }
+};
@@ -0,0 +1,664 @@
+#pragma once
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/task_arena.h>
+#include <tbb/task_group.h>
+
+#include "flow-async.hpp"
+#include "flow-memo.hpp"
+#include "flow-profile.hpp"
+#include "flow-scratch.hpp"
+
+#include <algorithm>
+#include <any>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <typeindex>
+#include <utility>
+#include <vector>
+
+// 端口只记录名字与值类型，连接时按类型校验；input_port/output_port 是派生节点在构造时拿到的带类型下标
+struct port_info
+{
+    std::string name;
+    std::type_index type;
+    size_t (*bytes)(const std::any&) = nullptr;
+};
+template <class T> struct input_port
+{
+    uint32_t index = 0;
+};
+template <class T> struct output_port
+{
+    uint32_t index = 0;
+};
+
+// 节点执行时的上下文：输入指向上游节点的输出值，只在 execute 期间有效
+class flow_context
+{
+    std::span<const std::any* const> inputs;
+    std::span<std::any> outputs;
+    std::pmr::memory_resource* scratch_resource;
+
+public:
+    flow_context(std::span<const std::any* const> inputs, std::span<std::any> outputs, std::pmr::memory_resource* scratch = nullptr)
+        : inputs(inputs), outputs(outputs), scratch_resource(scratch ? scratch : std::pmr::new_delete_resource())
+    {
+    }
+
+public:
+    // 临时内存，如 std::pmr::vector<cv::Point> points(ctx.scratch())；只在本次求值期间有效，不能放进输出端口。
+    // 执行器提供按线程整体回收的 flow_scratch_arena，直接调用 flow_graph::execute 时退回全局堆
+    std::pmr::memory_resource* scratch() const { return scratch_resource; }
+    // 未连接或上游尚未产出时返回 nullptr
+    template <class T> const T* try_input(input_port<T> port) const
+    {
+        auto value = inputs[port.index];
+        return value ? std::any_cast<T>(value) : nullptr;
+    }
+    template <class T> const T& input(input_port<T> port) const
+    {
+        if (auto value = try_input(port))
+            return *value;
+        throw std::logic_error("flow_context: 输入端口未连接或上游没有产出");
+    }
+    template <class T, class V> void output(output_port<T> port, V&& value) { outputs[port.index].template emplace<T>(std::forward<V>(value)); }
+    // 上次执行留下的输出值，可原地复用其内存；尚无该类型的值时默认构造一个
+    template <class T> T& output_value(output_port<T> port)
+    {
+        auto& value = outputs[port.index];
+        if (auto typed = std::any_cast<T>(&value))
+            return *typed;
+        return value.template emplace<T>();
+    }
+};
+
+struct node
+{
+private:
+    std::vector<port_info> input_ports;
+    std::vector<port_info> output_ports;
+    std::atomic<uint64_t> revision_counter = 0;
+
+public:
+    virtual ~node() = default;
+    virtual std::string describe() const { return "I am a node"; }
+    // 读取 ctx 中的输入并写出全部输出；同一节点不会被并发调用，不同节点会在多个线程上同时执行
+    virtual void execute(flow_context& ctx) { std::ignore = ctx; }
+    // 输出只由节点类型、参数与输入决定的节点返回参数的哈希，以便结果缓存；默认不缓存
+    virtual std::optional<uint64_t> parameter_hash() const { return std::nullopt; }
+
+public:
+    std::span<const port_info> inputs() const { return input_ports; }
+    std::span<const port_info> outputs() const { return output_ports; }
+    // 参数版本号：修改参数后调用 touch，下次执行时该节点及其下游会被重新计算
+    uint64_t revision() const { return revision_counter.load(std::memory_order_acquire); }
+    void touch() { revision_counter.fetch_add(1, std::memory_order_acq_rel); }
+
+protected:
+    template <class T> input_port<T> add_input(std::string name)
+    {
+        input_ports.push_back({ std::move(name), typeid(T), &value_bytes<T> });
+        return { static_cast<uint32_t>(input_ports.size() - 1) };
+    }
+    template <class T> output_port<T> add_output(std::string name)
+    {
+        output_ports.push_back({ std::move(name), typeid(T), &value_bytes<T> });
+        return { static_cast<uint32_t>(output_ports.size() - 1) };
+    }
+
+private:
+    template <class T> static size_t value_bytes(const std::any& value)
+    {
+        auto typed = std::any_cast<T>(&value);
+        return typed ? flow_value_size<T>::bytes(*typed) : 0;
+    }
+};
+
+// 异步节点：执行体是协程，co_await flow_reactor 的等待对象或 flow_event 时释放工作线程，就绪后由 flow_executor
+// 在 tbb 线程上恢复，等待期间同一图中的计算节点照常执行；适合文件读取、视频解码、进程间通信等以等待为主的阶段。
+// 执行器不为异步节点查询结果缓存，ctx.scratch() 取自全局堆（协程可能在另一个线程上恢复）。
+// 不经 flow_executor 执行时（flow_stream、flow_program 等）在当前线程阻塞到协程完成
+struct async_node : node
+{
+    virtual flow_task execute_async(flow_context& ctx) = 0;
+    void execute(flow_context& ctx) override { flow_run_blocking(execute_async(ctx)); }
+};
+
+// 节点图：节点按 id 连续存放，删除后留空位以保持 id 稳定；每个输入端口最多连接一个上游输出，
+// connect 拒绝类型不符或成环的连接，拓扑序在拓扑变化后首次执行前重建。
+// 每个节点的输出带版本号，节点记下上次计算时各输入的版本与自身参数版本，两者都没变的节点无需重新计算
+class flow_graph
+{
+public:
+    using index_t = uint32_t;
+    static constexpr index_t npos = static_cast<index_t>(-1);
+
+    struct source_t
+    {
+        index_t node = npos;
+        uint32_t port = 0;
+    };
+    struct slot_t
+    {
+        std::shared_ptr<node> instance;
+        std::vector<source_t> sources;
+        std::vector<index_t> successors;
+        std::vector<std::any> values;
+        std::vector<const std::any*> input_values;
+        std::vector<uint64_t> source_versions;
+        uint64_t version = 0;
+        uint64_t evaluated_revision = 0;
+        uint64_t content_key = 0;
+        bool dirty = true;
+    };
+
+private:
+    std::vector<slot_t> slots;
+    std::vector<index_t> order;
+    size_t live_count = 0;
+    // 全局递增，不同的图（包括先后在同一地址构造的图）之间也不会重复
+    static inline std::atomic<uint64_t> topology_counter = 0;
+    static inline std::atomic<uint64_t> id_counter = 0;
+    uint64_t graph_id = ++id_counter;
+    uint64_t topology_revision = ++topology_counter;
+    bool topology_dirty = false;
+
+public:
+    size_t size() const { return live_count; }
+    bool empty() const { return live_count == 0; }
+    size_t capacity() const { return slots.size(); }
+    // 进程内唯一的图编号，采样记录用它区分不同图中编号相同的节点
+    uint64_t id() const { return graph_id; }
+    bool contains(index_t id) const { return id < slots.size() && slots[id].instance != nullptr; }
+    const std::shared_ptr<node>& at(index_t id) const { return slots[id].instance; }
+    const slot_t& slot(index_t id) const { return slots[id]; }
+
+public:
+    index_t add(std::shared_ptr<node> instance)
+    {
+        if (!instance)
+            return npos;
+        slot_t slot;
+        slot.sources.assign(instance->inputs().size(), source_t{});
+        slot.values.resize(instance->outputs().size());
+        slot.input_values.assign(instance->inputs().size(), nullptr);
+        slot.source_versions.assign(instance->inputs().size(), 0);
+        slot.instance = std::move(instance);
+        slots.push_back(std::move(slot));
+        live_count++;
+        mark_topology_changed();
+        return static_cast<index_t>(slots.size() - 1);
+    }
+    bool remove(index_t id)
+    {
+        if (!contains(id))
+            return false;
+        for (uint32_t port = 0; port < slots[id].sources.size(); port++)
+            disconnect(id, port);
+        for (auto successor : std::vector<index_t>(slots[id].successors))
+            for (uint32_t port = 0; port < slots[successor].sources.size(); port++)
+                if (slots[successor].sources[port].node == id)
+                    disconnect(successor, port);
+        slots[id] = slot_t{};
+        live_count--;
+        mark_topology_changed();
+        return true;
+    }
+    bool connect(index_t from, uint32_t output, index_t to, uint32_t input)
+    {
+        if (!contains(from) || !contains(to) || from == to)
+            return false;
+        auto outputs = slots[from].instance->outputs();
+        auto inputs = slots[to].instance->inputs();
+        if (output >= outputs.size() || input >= inputs.size() || outputs[output].type != inputs[input].type)
+            return false;
+        if (reachable(to, from))
+            return false;
+        disconnect(to, input);
+        slots[to].sources[input] = { from, output };
+        slots[to].input_values[input] = &slots[from].values[output];
+        slots[to].dirty = true;
+        auto& successors = slots[from].successors;
+        if (std::find(successors.begin(), successors.end(), to) == successors.end())
+            successors.push_back(to);
+        mark_topology_changed();
+        return true;
+    }
+    template <class T> bool connect(index_t from, output_port<T> output, index_t to, input_port<T> input) { return connect(from, output.index, to, input.index); }
+    bool disconnect(index_t to, uint32_t input)
+    {
+        if (!contains(to) || input >= slots[to].sources.size() || slots[to].sources[input].node == npos)
+            return false;
+        auto from = std::exchange(slots[to].sources[input], source_t{}).node;
+        slots[to].input_values[input] = nullptr;
+        slots[to].dirty = true;
+        auto& sources = slots[to].sources;
+        if (std::none_of(sources.begin(), sources.end(), [from](const source_t& source) { return source.node == from; }))
+            std::erase(slots[from].successors, to);
+        mark_topology_changed();
+        return true;
+    }
+
+    // 节点 id 的拓扑序，只含存活节点
+    std::span<const index_t> plan()
+    {
+        if (topology_dirty)
+            build_order();
+        return order;
+    }
+    std::span<const index_t> topological_order() const { return order; }
+    bool planned() const { return !topology_dirty; }
+    // 每次增删节点或连接都会取一个进程内唯一的新值，编译出的执行计划只凭它判断是否过期，不依赖图的地址
+    uint64_t topology_version() const { return topology_revision; }
+
+    // 强制下次执行时重新计算该节点（及其下游）
+    void touch(index_t id)
+    {
+        if (contains(id))
+            slots[id].dirty = true;
+    }
+    void invalidate()
+    {
+        for (auto& slot : slots)
+            slot.dirty = true;
+    }
+    // 自身参数或连接变化，或任一输入的版本与上次计算时不同
+    bool stale(index_t id) const
+    {
+        auto& slot = slots[id];
+        if (slot.dirty || slot.evaluated_revision != slot.instance->revision())
+            return true;
+        for (size_t i = 0; i < slot.sources.size(); i++)
+            if (slot.sources[i].node != npos && slots[slot.sources[i].node].version != slot.source_versions[i])
+                return true;
+        return false;
+    }
+    // 按拓扑序收集需要重新计算的节点：过期节点及其全部下游；affected 按 id 标记，大小为 capacity()
+    void collect_stale(std::vector<index_t>& cone, std::vector<uint8_t>& affected)
+    {
+        plan();
+        cone.clear();
+        affected.assign(slots.size(), 0);
+        for (auto id : order)
+        {
+            bool upstream = std::any_of(slots[id].sources.begin(), slots[id].sources.end(), [&](const source_t& source) { return source.node != npos && affected[source.node]; });
+            if (upstream || stale(id))
+            {
+                affected[id] = 1;
+                cone.push_back(id);
+            }
+        }
+    }
+
+    // 上游节点数量（按去重后的上游节点计，只计 pred 为 true 的上游），执行器据此初始化依赖计数
+    template <class Pred> uint32_t predecessor_count(index_t id, Pred&& pred) const
+    {
+        uint32_t count = 0;
+        auto& sources = slots[id].sources;
+        for (size_t i = 0; i < sources.size(); i++)
+            if (sources[i].node != npos && pred(sources[i].node) && std::none_of(sources.begin(), sources.begin() + i, [&](const source_t& source) { return source.node == sources[i].node; }))
+                count++;
+        return count;
+    }
+    uint32_t predecessor_count(index_t id) const
+    {
+        return predecessor_count(id, [](index_t) { return true; });
+    }
+    // 执行节点并更新版本号，返回结果是否取自 memo；抛出异常时节点保持过期，下次执行会重试。
+    // 可缓存节点的内容键由类型、参数与输入的内容键组合，其它节点的内容键随每次重新计算变化
+    bool execute(index_t id, flow_memo_cache* memo = nullptr, std::pmr::memory_resource* scratch = nullptr)
+    {
+        auto& slot = slots[id];
+        auto revision = slot.instance->revision();
+        auto parameters = slot.instance->parameter_hash();
+        uint64_t key = parameters ? content_key_of(id, *parameters) : 0;
+        bool cached = parameters && memo && memo->lookup(key, slot.values);
+        if (!cached)
+        {
+            flow_context ctx(slot.input_values, slot.values, scratch);
+            slot.instance->execute(ctx);
+            if (parameters && memo)
+                memo->insert(key, slot.values, value_bytes(id));
+        }
+        commit(id, revision, parameters ? std::optional<uint64_t>(key) : std::nullopt);
+        return cached;
+    }
+    // 节点的输出已由外部（如融合执行）写好时，补上与 execute 相同的版本记录；revision 为开始执行时节点的参数版本
+    void mark_evaluated(index_t id) { mark_evaluated(id, slots[id].instance->revision()); }
+    void mark_evaluated(index_t id, uint64_t revision)
+    {
+        auto parameters = slots[id].instance->parameter_hash();
+        commit(id, revision, parameters ? std::optional<uint64_t>(content_key_of(id, *parameters)) : std::nullopt);
+    }
+    // 输出被省略的中间节点（融合或分块执行时只存在于临时缓冲）：同样记录版本供下游计算内容键，但清空输出并保持过期，
+    // 之后逐节点执行到它的下游时会先重新计算它
+    void mark_elided(index_t id)
+    {
+        mark_evaluated(id);
+        for (auto& value : slots[id].values)
+            value.reset();
+        slots[id].dirty = true;
+    }
+    // 节点的输入与输出值，供绕过 execute 直接读写的执行方式使用
+    const std::any* input_value(index_t id, uint32_t port) const { return slots[id].input_values[port]; }
+    std::span<std::any> output_values(index_t id) { return slots[id].values; }
+    size_t value_bytes(index_t id) const
+    {
+        auto& slot = slots[id];
+        auto ports = slot.instance->outputs();
+        size_t bytes = 0;
+        for (size_t i = 0; i < slot.values.size(); i++)
+            bytes += ports[i].bytes(slot.values[i]);
+        return bytes;
+    }
+    template <class T> const T* value(index_t id, output_port<T> port) const
+    {
+        if (!contains(id) || port.index >= slots[id].values.size())
+            return nullptr;
+        return std::any_cast<T>(&slots[id].values[port.index]);
+    }
+
+private:
+    void mark_topology_changed()
+    {
+        topology_dirty = true;
+        topology_revision = ++topology_counter;
+    }
+    void commit(index_t id, uint64_t revision, std::optional<uint64_t> key)
+    {
+        auto& slot = slots[id];
+        for (size_t i = 0; i < slot.sources.size(); i++)
+            slot.source_versions[i] = slot.sources[i].node != npos ? slots[slot.sources[i].node].version : 0;
+        slot.evaluated_revision = revision;
+        slot.version++;
+        slot.content_key = key ? *key : flow_hash_mix(reinterpret_cast<uintptr_t>(slot.instance.get()), slot.version);
+        slot.dirty = false;
+    }
+    uint64_t content_key_of(index_t id, uint64_t parameters) const
+    {
+        auto& slot = slots[id];
+        uint64_t key = flow_hash_mix(typeid(*slot.instance).hash_code(), parameters);
+        for (auto& source : slot.sources)
+            key = flow_hash_mix(key, source.node != npos ? flow_hash_mix(slots[source.node].content_key, source.port) : 0);
+        return key;
+    }
+    bool reachable(index_t from, index_t to) const
+    {
+        std::vector<index_t> stack{ from };
+        std::vector<bool> visited(slots.size(), false);
+        while (!stack.empty())
+        {
+            auto id = stack.back();
+            stack.pop_back();
+            if (id == to)
+                return true;
+            if (visited[id])
+                continue;
+            visited[id] = true;
+            stack.insert(stack.end(), slots[id].successors.begin(), slots[id].successors.end());
+        }
+        return false;
+    }
+    void build_order()
+    {
+        std::vector<uint32_t> pending(slots.size(), 0);
+        order.clear();
+        order.reserve(live_count);
+        for (index_t id = 0; id < slots.size(); id++)
+        {
+            if (!contains(id))
+                continue;
+            pending[id] = predecessor_count(id);
+            if (pending[id] == 0)
+                order.push_back(id);
+        }
+        for (size_t i = 0; i < order.size(); i++)
+            for (auto successor : slots[order[i]].successors)
+                if (--pending[successor] == 0)
+                    order.push_back(successor);
+        topology_dirty = false;
+    }
+};
+
+// 单次执行的统计：时间点均相对执行开始；关键路径为依赖链上节点耗时之和最大的一条
+struct flow_run_report
+{
+    using duration = std::chrono::nanoseconds;
+    struct node_timing
+    {
+        duration begin = {};
+        duration end = {};
+        bool cached = false;
+    };
+
+    duration wall = {};
+    duration work = {};
+    duration critical_path = {};
+    std::vector<flow_graph::index_t> critical_nodes;
+    std::vector<node_timing> timings;
+    // 本次重新计算与因输入和参数均未变化而跳过的节点，均按拓扑序
+    std::vector<flow_graph::index_t> executed;
+    std::vector<flow_graph::index_t> skipped;
+    // 各工作线程临时内存的用量之和
+    size_t scratch_bytes = 0;
+
+    // 理论可达的平均并行度 work / critical_path，宽图应接近核数
+    double parallelism() const { return critical_path.count() > 0 ? static_cast<double>(work.count()) / static_cast<double>(critical_path.count()) : 0.0; }
+};
+
+// 在 tbb 的工作窃取调度器上执行节点图：依赖计数归零的后继中第一个在当前线程接着执行，其余提交到 task_group，
+// 链状部分不产生额外任务，宽的部分由空闲线程窃取。只调度过期节点及其下游，其余节点保留上次的输出。
+// 异步节点挂起时工作线程转去执行其它节点，协程完成后由一个预先登记在 task_group 中的任务接着释放它的后继
+class flow_executor
+{
+    using index_t = flow_graph::index_t;
+    using clock = std::chrono::steady_clock;
+
+    // 协程的每次恢复作为一个 tbb 任务放进执行器的 arena
+    class arena_scheduler : public flow_scheduler
+    {
+        tbb::task_arena& arena;
+
+    public:
+        explicit arena_scheduler(tbb::task_arena& arena) : arena(arena) {}
+        void schedule(std::coroutine_handle<> handle) override
+        {
+            arena.enqueue([handle] { handle.resume(); });
+        }
+    };
+    // 正在执行的异步节点；finish 在节点开始时由 group.defer 创建，使 group.wait 一直等到协程完成
+    struct async_state
+    {
+        tbb::task_arena* arena = nullptr;
+        std::optional<flow_context> ctx;
+        flow_task task;
+        tbb::task_handle finish;
+        uint64_t revision = 0;
+        int64_t profile_begin = 0;
+    };
+
+    tbb::task_arena arena;
+    arena_scheduler scheduler{ arena };
+    std::vector<std::unique_ptr<async_state>> async_states;
+    std::unique_ptr<std::atomic<uint32_t>[]> pending;
+    size_t pending_capacity = 0;
+    std::vector<uint8_t> affected;
+    flow_memo_cache* memo = nullptr;
+    flow_profiler* profiler = nullptr;
+    flow_profiler* profiling = nullptr;
+    uint64_t profile_run = 0;
+    tbb::enumerable_thread_specific<flow_scratch_arena> scratch;
+
+public:
+    explicit flow_executor(int concurrency = tbb::task_arena::automatic) : arena(concurrency) {}
+
+public:
+    int concurrency() { return arena.max_concurrency(); }
+    // 可缓存节点在执行前先查询 cache；cache 需比执行器活得久，可在多个执行器与节点图间共享
+    void set_memo_cache(flow_memo_cache* cache) { memo = cache; }
+    // 开启采样时每个节点的执行写入 profiler；是否采样在每次 run 开始时决定
+    void set_profiler(flow_profiler* target) { profiler = target; }
+
+    // 节点抛出的异常在全部已提交任务结束后由 run 重新抛出。各工作线程的临时内存在最后一个节点结束后
+    // （包括因异常退出时）整体回收，节点取得的临时指针不会留到下一次 run
+    flow_run_report run(flow_graph& graph)
+    {
+        struct scratch_guard
+        {
+            tbb::enumerable_thread_specific<flow_scratch_arena>* arenas;
+            ~scratch_guard()
+            {
+                for (auto& local : *arenas)
+                    local.reset();
+            }
+        } guard{ &scratch };
+        flow_run_report report;
+        graph.collect_stale(report.executed, affected);
+        for (auto id : graph.topological_order())
+            if (!affected[id])
+                report.skipped.push_back(id);
+        report.timings.assign(graph.capacity(), {});
+        auto& order = report.executed;
+        if (order.empty())
+            return report;
+
+        if (pending_capacity < graph.capacity())
+        {
+            pending = std::make_unique<std::atomic<uint32_t>[]>(graph.capacity());
+            pending_capacity = graph.capacity();
+        }
+        if (async_states.size() < graph.capacity())
+            async_states.resize(graph.capacity());
+        std::vector<index_t> roots;
+        for (auto id : order)
+        {
+            auto count = graph.predecessor_count(id, [this](index_t source) { return affected[source] != 0; });
+            pending[id].store(count, std::memory_order_relaxed);
+            if (count == 0)
+                roots.push_back(id);
+        }
+
+        profiling = profiler && profiler->enabled() ? profiler : nullptr;
+        profile_run = profiling ? profiling->begin_run() : 0;
+        auto start = clock::now();
+        arena.execute([&] {
+            tbb::task_group group;
+            for (auto id : roots)
+                group.run([&, id] { run_chain(graph, group, report, start, id); });
+            group.wait();
+        });
+        report.wall = clock::now() - start;
+        for (auto& local : scratch)
+            report.scratch_bytes += local.stats().bytes_used;
+        critical_path(graph, order, report);
+        return report;
+    }
+
+private:
+    void run_chain(flow_graph& graph, tbb::task_group& group, flow_run_report& report, clock::time_point start, index_t id)
+    {
+        auto& local = scratch.local();
+        while (id != flow_graph::npos)
+        {
+            auto& timing = report.timings[id];
+            timing.begin = clock::now() - start;
+            if (auto async = dynamic_cast<async_node*>(graph.at(id).get()))
+            {
+                start_async(graph, group, report, start, id, *async);
+                return;
+            }
+            {
+                flow_profile_scope sample(profiling, profile_run, graph.id(), id);
+                timing.cached = graph.execute(id, memo, &local);
+                if (sample.active())
+                    sample.set_cache(timing.cached ? flow_profile_record::cache_state::hit
+                                                   : (memo && graph.at(id)->parameter_hash() ? flow_profile_record::cache_state::miss : flow_profile_record::cache_state::none));
+            }
+            timing.end = clock::now() - start;
+            id = release_successors(graph, group, report, start, id);
+        }
+    }
+    // 依赖计数归零的后继中第一个返回给调用方接着执行，其余提交到 task_group
+    index_t release_successors(flow_graph& graph, tbb::task_group& group, flow_run_report& report, clock::time_point start, index_t id)
+    {
+        auto next = flow_graph::npos;
+        for (auto successor : graph.slot(id).successors)
+        {
+            if (pending[successor].fetch_sub(1, std::memory_order_acq_rel) != 1)
+                continue;
+            if (next == flow_graph::npos)
+                next = successor;
+            else
+                group.run([&, successor] { run_chain(graph, group, report, start, successor); });
+        }
+        return next;
+    }
+    // 协程在当前线程执行到第一次挂起；完成时把 finish 放进 arena，由它记录结果并接着执行后继
+    void start_async(flow_graph& graph, tbb::task_group& group, flow_run_report& report, clock::time_point start, index_t id, async_node& instance)
+    {
+        auto& state = async_states[id];
+        if (!state)
+            state = std::make_unique<async_state>();
+        state->arena = &arena;
+        state->revision = instance.revision();
+        state->profile_begin = profiling ? profiling->now_ns() : 0;
+        state->ctx.emplace(graph.slot(id).input_values, graph.output_values(id));
+        state->task = instance.execute_async(*state->ctx);
+        state->finish = group.defer([this, &graph, &group, &report, start, id] {
+            auto& state = *async_states[id];
+            report.timings[id].end = clock::now() - start;
+            if (profiling)
+            {
+                flow_profile_record record{ profile_run, id };
+                record.graph = graph.id();
+                record.begin_ns = state.profile_begin;
+                record.wall_ns = profiling->now_ns() - state.profile_begin;
+                record.cpu_ns = -1;
+                record.async = true;
+                profiling->record(record);
+            }
+            state.task.result();
+            graph.mark_evaluated(id, state.revision);
+            run_chain(graph, group, report, start, release_successors(graph, group, report, start, id));
+        });
+        state->task.start(
+            scheduler, [](void* context) {
+                auto state = static_cast<async_state*>(context);
+                state->arena->enqueue(std::move(state->finish));
+            },
+            state.get());
+    }
+    static void critical_path(const flow_graph& graph, std::span<const index_t> order, flow_run_report& report)
+    {
+        std::vector<flow_run_report::duration> longest(graph.capacity(), flow_run_report::duration::zero());
+        std::vector<index_t> previous(graph.capacity(), flow_graph::npos);
+        index_t last = flow_graph::npos;
+        for (auto id : order)
+        {
+            auto cost = report.timings[id].end - report.timings[id].begin;
+            report.work += cost;
+            for (auto& source : graph.slot(id).sources)
+                if (source.node != flow_graph::npos && longest[source.node] > longest[id])
+                {
+                    longest[id] = longest[source.node];
+                    previous[id] = source.node;
+                }
+            longest[id] += cost;
+            if (last == flow_graph::npos || longest[id] > longest[last])
+                last = id;
+        }
+        report.critical_path = longest[last];
+        for (auto id = last; id != flow_graph::npos; id = previous[id])
+            report.critical_nodes.push_back(id);
+        std::reverse(report.critical_nodes.begin(), report.critical_nodes.end());
+    }
+};
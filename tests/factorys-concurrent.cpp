@@ -0,0 +1,154 @@
+#include "factorys-concurrent.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 多个线程并发注册并不时发布、一个线程不停取快照（有未发布的修改时由它发布）并遍历：每个快照的 begin/end 必须配对，回调给出的路径与节点名字一致，
+// 工厂数随版本单调不减，最终快照包含全部注册过的路径，且每个工厂都是注册时传入的那一个
+
+using manager_t = concurrent_factory_group_manager<std::function<size_t()>>;
+using status_t = manager_t::manager::stack_status;
+
+static std::atomic<size_t> failures = 0;
+
+#define CHECK(condition)                                                                                                                                                                               \
+    do                                                                                                                                                                                                 \
+    {                                                                                                                                                                                                  \
+        if (!(condition) && failures.fetch_add(1) < 16)                                                                                                                                                \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl;                                                                                                 \
+    } while (false)
+
+static std::string make_path(size_t writer, size_t i)
+{
+    return "写入" + std::to_string(writer) + "/分组" + std::to_string(i % 8) + "/节点" + std::to_string(i);
+}
+static std::string make_group_path(size_t writer, size_t group)
+{
+    return "写入" + std::to_string(writer) + "/分组" + std::to_string(group);
+}
+
+// 遍历一个快照，检查结构并返回其中全部工厂的完整路径
+static std::set<std::string> check_snapshot(const manager_t::manager& groups)
+{
+    std::set<std::string> paths;
+    std::vector<std::string_view> stack;
+    std::vector<uint32_t> ids;
+    groups.visit_pruned([&](std::span<const std::string_view> path, status_t status, bool, manager_t::manager::group group) {
+        CHECK(path.size() == stack.size() + (status == status_t::end ? 0 : 1));
+        CHECK(!path.empty() && path.back() == group.name());
+        for (size_t i = 0; i < std::min(stack.size(), path.size()); i++)
+            CHECK(path[i] == stack[i]);
+
+        if (status == status_t::begin)
+        {
+            CHECK(group.is_sub_group());
+            stack.push_back(group.name());
+            ids.push_back(group.index());
+        }
+        else if (status == status_t::end)
+        {
+            // end 的路径与配对的 begin 相同，此时 stack 尚未弹出
+            CHECK(!ids.empty() && ids.back() == group.index());
+            if (!ids.empty())
+            {
+                ids.pop_back();
+                stack.pop_back();
+            }
+        }
+        else
+        {
+            CHECK(group.is_has_factory());
+            bool self = !ids.empty() && ids.back() == group.index();
+            std::string full;
+            for (size_t i = 0; i < path.size() - (self ? 1 : 0); i++)
+                full.append(full.empty() ? "" : "/").append(path[i]);
+            if (group.is_has_factory())
+                CHECK(group.factory()() == std::hash<std::string>{}(full));
+            paths.insert(std::move(full));
+        }
+        return true;
+    });
+    CHECK(stack.empty());
+    return paths;
+}
+
+int main()
+{
+    const size_t writers = std::max<size_t>(std::thread::hardware_concurrency(), 4);
+    constexpr size_t per_writer = 400;
+
+    manager_t factorys;
+    std::atomic<size_t> finished = 0;
+    size_t snapshots = 0;
+
+    std::thread reader([&] {
+        size_t last_count = 0;
+        uint64_t last_version = 0;
+        const manager_t::manager* last = nullptr;
+        while (true)
+        {
+            bool done = finished.load() == writers;
+            auto version = factorys.version();
+            auto snapshot = factorys.snapshot();
+            CHECK(version >= last_version);
+            last_version = version;
+            if (snapshot.get() != last)
+            {
+                last = snapshot.get();
+                auto count = check_snapshot(*snapshot).size();
+                CHECK(count >= last_count);
+                last_count = count;
+                snapshots++;
+            }
+            if (done)
+                break;
+        }
+    });
+
+    std::vector<std::thread> threads;
+    for (size_t writer = 0; writer < writers; writer++)
+        threads.emplace_back([&, writer] {
+            for (size_t i = 0; i < per_writer; i++)
+            {
+                auto path = make_path(writer, i);
+                auto id = std::hash<std::string>{}(path);
+                CHECK(factorys.register_group_from_absolute_path(path, [id] { return id; }));
+                // 分组自身也挂工厂，遍历时作为同名的第一个子项出现
+                if (i % 50 == 0)
+                {
+                    auto group_path = make_group_path(writer, i / 50 % 8);
+                    auto group_id = std::hash<std::string>{}(group_path);
+                    CHECK(factorys.register_group_from_absolute_path(group_path, [group_id] { return group_id; }));
+                }
+                // 写入方也不时主动发布，与读取方的按需发布竞争发布标志
+                if (i % 37 == 0)
+                    factorys.publish();
+            }
+            finished.fetch_add(1);
+        });
+    for (auto& thread : threads)
+        thread.join();
+    reader.join();
+
+    std::set<std::string> expected;
+    for (size_t writer = 0; writer < writers; writer++)
+    {
+        for (size_t i = 0; i < per_writer; i++)
+            expected.insert(make_path(writer, i));
+        for (size_t group = 0; group < 8; group++)
+            expected.insert(make_group_path(writer, group));
+    }
+    auto final_paths = check_snapshot(*factorys.snapshot());
+    CHECK(final_paths == expected);
+
+    std::cout << writers << " writers, " << expected.size() << " paths, " << snapshots << " snapshots checked, " << failures.load() << " failures" << std::endl;
+    return failures.load() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,74 @@
+#include "factorys.hpp"
+
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+// factory_group_manager 的回归用例：修改（包括 reserve）之后菜单计划必须重建，遍历得到的路径视图不能指向已释放的名字区
+
+using manager_t = factory_group_manager<std::function<int()>>;
+using status_t = manager_t::stack_status;
+
+static size_t failures = 0;
+
+#define CHECK(condition)                                                                                                                                                                               \
+    do                                                                                                                                                                                                 \
+    {                                                                                                                                                                                                  \
+        if (!(condition) && failures++ < 16)                                                                                                                                                           \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl;                                                                                                 \
+    } while (false)
+
+// 以 "/" 连接遍历到的全部工厂路径
+static std::vector<std::string> collect(manager_t& groups)
+{
+    std::vector<std::string> paths;
+    groups.visit_pruned([&](std::span<const std::string_view> path, status_t status, bool, manager_t::group) {
+        if (status == status_t::content)
+        {
+            std::string full;
+            for (auto name : path)
+                full.append(full.empty() ? "" : "/").append(name);
+            paths.push_back(std::move(full));
+        }
+        return true;
+    });
+    return paths;
+}
+
+// 先构建菜单计划再 reserve：名字区被搬移后，旧计划里的视图不能再被遍历
+static void reserve_after_plan()
+{
+    const std::string first = std::string(64, 'a') + "/" + std::string(64, 'b');
+    const std::string second = std::string(64, 'c') + "/" + std::string(64, 'd');
+
+    manager_t groups;
+    CHECK(groups.register_group_from_absolute_path(first, [] { return 1; }));
+    CHECK(groups.register_group_from_absolute_path(second, [] { return 2; }));
+    groups.plan();
+
+    auto revision = groups.revision();
+    groups.reserve(100000, 100000, 10000000);
+    CHECK(groups.revision() != revision);
+
+    // const 遍历在计划重建前不应产生任何回调
+    size_t stale = 0;
+    std::as_const(groups).visit_pruned([&](auto&&...) {
+        stale++;
+        return true;
+    });
+    CHECK(stale == 0);
+
+    CHECK((collect(groups) == std::vector<std::string>{ first, second }));
+}
+
+int main()
+{
+    reserve_after_plan();
+
+    std::cout << failures << " failures" << std::endl;
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
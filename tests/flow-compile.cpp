@@ -0,0 +1,88 @@
+#include "flow-compile.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <vector>
+
+// 融合执行必须与逐节点执行逐位一致：两者写入同样的内容键，记忆缓存把它们当作可互换的结果
+
+static size_t failures = 0;
+
+#define CHECK(condition)                                                                                                                                                                               \
+    do                                                                                                                                                                                                 \
+    {                                                                                                                                                                                                  \
+        if (!(condition) && failures++ < 16)                                                                                                                                                           \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl;                                                                                                 \
+    } while (false)
+
+struct image_node : node
+{
+    cv::Mat image;
+    output_port<cv::Mat> out = add_output<cv::Mat>("out");
+    void execute(flow_context& ctx) override { ctx.output(out, image); }
+};
+
+// 依次连接 chain，返回链尾的节点编号
+static flow_graph::index_t build_chain(flow_graph& graph, const cv::Mat& image, std::span<const std::shared_ptr<elementwise_node>> chain)
+{
+    auto source = std::make_shared<image_node>();
+    source->image = image;
+    auto previous = graph.add(source);
+    auto previous_port = source->out.index;
+    for (auto& step : chain)
+    {
+        auto id = graph.add(step);
+        CHECK(graph.connect(previous, previous_port, id, step->src.index));
+        previous = id;
+        previous_port = step->dst.index;
+    }
+    return previous;
+}
+
+static void compare_fused(int type)
+{
+    // 宽度不是向量宽度的倍数，覆盖内核的标量尾部；0.5 与 2 相继缩放在 8 位下每步都要取整
+    cv::Mat image(37, 333, type);
+    cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(255));
+    std::shared_ptr<elementwise_node> chain[] = {
+        std::make_shared<scale_node>(0.5f, 0.0f),
+        std::make_shared<scale_node>(2.0f, 0.0f),
+        std::make_shared<scale_node>(1.3f, -20.0f),
+        std::make_shared<clamp_node>(0.0f, 200.0f),
+        std::make_shared<color_convert_node>(pixel_op::bgr_to_gray()),
+        std::make_shared<scale_node>(0.7f, 3.5f),
+    };
+    flow_graph graph;
+    auto tail = build_chain(graph, image, chain);
+    auto dst = chain[std::size(chain) - 1]->dst;
+
+    flow_executor executor;
+    executor.run(graph);
+    auto value = graph.value(tail, dst);
+    CHECK(value != nullptr);
+    if (!value)
+        return;
+    cv::Mat expected = value->clone();
+
+    graph.invalidate();
+    flow_program program;
+    program.run(graph);
+    CHECK(program.fused_node_count() == std::size(chain));
+    value = graph.value(tail, dst);
+    CHECK(value != nullptr);
+    if (!value)
+        return;
+    CHECK(value->type() == expected.type() && value->size() == expected.size());
+    CHECK(cv::norm(*value, expected, cv::NORM_INF) == 0.0);
+}
+
+int main()
+{
+    compare_fused(CV_8UC3);
+    compare_fused(CV_32FC3);
+
+    std::cout << failures << " failures" << std::endl;
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}